@@ -0,0 +1,191 @@
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "analysis.h"
+#include "search.h"
+#include "eval.h"
+#include "clock.h"
+#include "nnue-probe/nnue.h"
+
+// the four position fields of an epd line, with the move counters of a full
+// fen kept when they are there
+std::string Analysis::epdToFen(const std::string& line)
+{
+	std::istringstream stream(line);
+	std::string fen;
+	std::string field;
+
+	for (auto i = 0; i < 6 && stream >> field; i++)
+	{
+		if (i >= 4 && field.find_first_not_of("0123456789") != std::string::npos)
+			break;
+		fen += field + " ";
+	}
+	return fen;
+}
+
+// the operand of the id opcode, without its quotes
+std::string Analysis::epdId(const std::string& line)
+{
+	const size_t opcode = line.find(" id ");
+
+	if (opcode == std::string::npos)
+		return {};
+
+	const size_t begin = line.find_first_not_of(" \"", opcode + 4);
+	const size_t end = line.find_first_of("\";", begin);
+	return begin == std::string::npos ? std::string() : line.substr(begin, end - begin);
+}
+
+int Analysis::analyzeFile(const std::string& fileName, const Limit limit, const uint64_t value)
+{
+	std::ifstream file(fileName);
+
+	if (!file)
+	{
+		std::cout << "info string cannot open " << fileName << std::endl;
+		return 1;
+	}
+
+	std::mutex io;
+	uint64_t positions = 0;
+	uint64_t totalNodes = 0;
+
+	Search::stopSignal = false;
+	const Clock timer = Clock::startNow();
+
+	auto worker = [&]
+	{
+		Search::analysing = true;
+		Search::sendOutput = false;
+		Eval::cache.setSize(Eval::cacheSize);
+		SearchInfo& info = Search::searchInfo;
+		const auto position = std::make_unique<Pos>();
+		std::string line;
+
+		while (true)
+		{
+			uint64_t index;
+			{
+				std::lock_guard<std::mutex> lock(io);
+
+				while (std::getline(file, line) && (line.empty() || line[0] == '#'))
+				{
+				}
+
+				if (!file)
+					break;
+				index = ++positions;
+				// a new generation per round of Search::cores positions: the
+				// entries of the rounds already done age out, while those of
+				// positions still being searched age by one round at most
+				if ((index - 1) % Search::cores == 0)
+					Search::Hash.newSearch();
+			}
+
+			position->loadFen(epdToFen(line));
+			info.newSearch(limit == Limit::MoveTime ? static_cast<int>(value) : static_cast<int>(SearchInfo::Time::Infinite));
+			info.setDepthLimit(limit == Limit::Depth ? static_cast<int>(value) : 100);
+			info.setNodeLimit(limit == Limit::Nodes ? value : 0);
+			Search::aborted = false;
+
+			const SearchResult result = Search::iterativeSearch(*position);
+			const std::string id = epdId(line);
+
+			std::ostringstream out;
+			out << "analysis " << index;
+			if (!id.empty())
+				out << " id " << id;
+			out << " depth " << result.Depth;
+			// a root with a single legal move is not searched and has no score
+			if (std::abs(result.Score) < Search::Infinity)
+				out << " score " << Search::scoreToUci(result.Score);
+			out << " nodes " << info.Nodes()
+				<< " time " << info.elapsedTime()
+				<< " bestmove " << (result.BestMove.isNull() ? "(none)" : result.BestMove.toAlgebraic())
+				<< " pv " << Search::getPV(*position, result.BestMove, result.Depth);
+
+			std::lock_guard<std::mutex> lock(io);
+			totalNodes += info.Nodes();
+			std::cout << out.str() << std::endl;
+		}
+		Search::analysing = false;
+	};
+
+	std::vector<std::thread> workers;
+
+	for (auto i = 1; i < Search::cores; i++)
+		workers.emplace_back(worker);
+	worker();
+
+	for (auto& thread : workers)
+		thread.join();
+
+	Search::stopSignal = true;
+	const double time = timer.elapsedMilliseconds();
+	std::cout << "info string analysed " << positions << " positions nodes " << totalNodes
+		<< " time " << time << " nps " << static_cast<uint64_t>(time > 0 ? totalNodes * 1000 / time : 0) << std::endl;
+	return 0;
+}
+
+// the static evaluation of every position, relative to the side to move.
+// lines are read a batch at a time and the network scores the batch in one
+// call
+int Analysis::evaluateFile(const std::string& fileName)
+{
+	std::ifstream file(fileName);
+
+	if (!file)
+	{
+		std::cout << "info string cannot open " << fileName << std::endl;
+		return 1;
+	}
+
+	constexpr size_t batch = 1024;
+	std::vector<std::string> lines;
+	std::vector<std::string> fens;
+	std::vector<const char*> fenPtrs;
+	std::vector<int> scores(batch);
+	uint64_t positions = 0;
+	std::string line;
+	const Clock timer = Clock::startNow();
+
+	while (file)
+	{
+		lines.clear();
+		fens.clear();
+		fenPtrs.clear();
+
+		while (lines.size() < batch && std::getline(file, line))
+		{
+			if (line.empty() || line[0] == '#')
+				continue;
+			lines.push_back(line);
+			fens.push_back(epdToFen(line));
+		}
+
+		for (const auto& fen : fens)
+			fenPtrs.push_back(fen.c_str());
+		nnue_evaluate_fen_batch(static_cast<int>(fenPtrs.size()), fenPtrs.data(), scores.data());
+
+		std::ostringstream out;
+		for (size_t i = 0; i < lines.size(); i++)
+		{
+			const std::string id = epdId(lines[i]);
+			out << "evaluation " << ++positions;
+			if (!id.empty())
+				out << " id " << id;
+			out << " score cp " << scores[i] << "\n";
+		}
+		std::cout << out.str();
+	}
+
+	const double time = timer.elapsedMilliseconds();
+	std::cout << "info string evaluated " << positions << " positions time " << time
+		<< " eps " << static_cast<uint64_t>(time > 0 ? positions * 1000 / time : 0) << std::endl;
+	return 0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// offline analysis of an epd file. the positions are handed out to Search::cores
+// worker threads, each searching its own position on its own, and a line is
+// printed as soon as a position is done. evaluateFile only scores them with
+// the network, in batches
+namespace Analysis
+{
+	enum class Limit
+	{
+		Depth,
+		Nodes,
+		MoveTime
+	};
+
+	int analyzeFile(const std::string&, Limit, uint64_t);
+	int evaluateFile(const std::string&);
+	std::string epdToFen(const std::string&);
+	std::string epdId(const std::string&);
+}
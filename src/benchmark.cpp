@@ -6,31 +6,98 @@
 #include "uci.h"
 #include "search.h"
 #include "searchinfo.h"
-#include <windows.h>
+#include "eval.h"
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
 
-Benchmark::Benchmark(Pos& position) :
+Benchmark::Benchmark(Pos& position, const int hashSize) :
 	position(position)
 {
+	if (hashSize > 0)
+		table = std::make_unique<PerftTable>(hashSize);
 }
 
-uint64_t Benchmark::Perft(const int depth)
+// bulk counting: the moves of the last ply are counted, not made
+uint64_t Benchmark::Perft(Pos& position, const int depth, PerftTable* table)
 {
+	if (depth == 0)
+		return 1;
+
+	uint64_t nodes;
+
+	if (depth > 1 && table && table->Probe(position.zobrist, depth, nodes))
+		return nodes;
+
+	nodes = 0;
 	int pos = 0;
 	Move moves[moveGen::maxMoves];
-	uint64_t nodes = 0;
 	moveGen::getLegalMoves(moves, pos, position);
 
 	if (depth == 1)
 		return pos;
-	if (depth == 0)
-		return 1;
 
 	for (int i = 0; i < pos; i++)
 	{
 		position.makeMove(moves[i]);
-		nodes += Perft(depth - 1);
+		nodes += Perft(position, depth - 1, table);
 		position.undoMove(moves[i]);
 	}
+
+	if (table)
+		table->Save(position.zobrist, depth, nodes);
+	return nodes;
+}
+
+// counts below every root move, with the root moves handed out one at a time
+// to Search::cores threads, each walking its own copy of the position
+int Benchmark::splitRoot(const int depth, Move moves[], uint64_t counts[])
+{
+	int count = 0;
+	moveGen::getLegalMoves(moves, count, position);
+
+	RootState root;
+	position.saveState(root);
+	std::atomic<int> next = 0;
+
+	auto worker = [&]
+	{
+		const auto copy = std::make_unique<Pos>();
+		copy->loadState(root);
+
+		for (int i; (i = next++) < count;)
+		{
+			copy->makeMove(moves[i]);
+			counts[i] = Perft(*copy, depth - 1, table.get());
+			copy->undoMove(moves[i]);
+		}
+	};
+
+	std::vector<std::thread> threads;
+
+	for (int i = 1; i < std::min(Search::cores, count); i++)
+		threads.emplace_back(worker);
+	worker();
+
+	for (auto& thread : threads)
+		thread.join();
+	return count;
+}
+
+uint64_t Benchmark::Perft(const int depth)
+{
+	if (depth < 2)
+		return Perft(position, depth, nullptr);
+
+	Move moves[moveGen::maxMoves];
+	uint64_t counts[moveGen::maxMoves];
+	uint64_t nodes = 0;
+	const int count = splitRoot(depth, moves, counts);
+
+	for (int i = 0; i < count; i++)
+		nodes += counts[i];
 	return nodes;
 }
 
@@ -52,22 +119,18 @@ void Benchmark::runPerft(const int depth)
 
 uint64_t Benchmark::Divide(const int depth)
 {
-	int pos = 0;
 	Move moves[moveGen::maxMoves];
+	uint64_t counts[moveGen::maxMoves];
 	uint64_t nodes = 0;
-	int32_t moveNum = 0;
-	moveGen::getLegalMoves(moves, pos, position);
+	const int count = splitRoot(std::max(depth, 1), moves, counts);
 
-	for (int i = 0; i < pos; i++)
+	for (int i = 0; i < count; i++)
 	{
-		position.makeMove(moves[i]);
-		const uint64_t delta = Loop(depth - 1);
-		nodes += delta;
-		position.undoMove(moves[i]);
-		std::string num = int32ToStr(++moveNum);
+		nodes += counts[i];
+		std::string num = int32ToStr(i + 1);
 		if (1 == num.size())
 			num = " " + num;
-		std::string line = "move " + num + ": " + moves[i].toAlgebraic() + " " + int64ToStr(delta) + " nodes";
+		std::string line = "move " + num + ": " + moves[i].toAlgebraic() + " " + int64ToStr(counts[i]) + " nodes";
 		std::cout << line << std::endl;
 	}
 	return nodes;
@@ -89,25 +152,6 @@ void Benchmark::runDivide(const int depth)
 	std::cout << ss.str();
 }
 
-uint64_t Benchmark::Loop(const int depth)
-{
-	int pos = 0;
-	if (depth == 0)
-		return 1;
-
-	Move moves[moveGen::maxMoves];
-	moveGen::getLegalMoves(moves, pos, position);
-	uint64_t count = 0;
-
-	for (int i = 0; i < pos; ++i)
-	{
-		position.makeMove(moves[i]);
-		count += Perft(depth - 1);
-		position.undoMove(moves[i]);
-	}
-	return count;
-}
-
 struct PerftItem
 {
 	std::string fen;
@@ -122,21 +166,10 @@ struct PerftItem
 	}
 };
 
-struct BenchItem
-{
-	std::string fen;
-
-	explicit BenchItem(const std::string& f)
-	{
-		fen = f;
-	}
-};
-
 void Benchmark::perftTest()
 {
 	using vecPerftItems = std::vector<PerftItem>;
 	vecPerftItems items;
-	Pos position;
 
 	items.push_back(PerftItem("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 1, 20));
 	items.push_back(PerftItem("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 2, 400));
@@ -164,119 +197,282 @@ void Benchmark::perftTest()
 	position.loadFen(startPosition);
 }
 
-void Benchmark::ttdTest(const int depth) const
+// mates in one, which perft cannot catch: a mated side with no legal moves
+// has to be scored as mated, not as stalemate
+static const char* const matePositions[][2] =
 {
-	static FILE* benchLog;
-	static char fileName[256];
-	char buf[256];
+	{"6k1/5ppp/8/8/8/8/5PPP/R5K1 w - -", "a1a8"},
+	{"r5k1/5ppp/8/8/8/8/5PPP/6K1 b - -", "a8a1"},
+	{"r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq -", "h5f7"},
+};
 
-	Search::depth_limit = depth;
-	auto type = SearchType::Infinite;
-	using vecBenchItems = std::vector<BenchItem>;
-	vecBenchItems items;
-
-	items.push_back(BenchItem("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -"));
-	items.push_back(BenchItem("r1bn1rk1/ppp1qppp/3pp3/3P4/2P1n3/2B2NP1/PP2PPBP/2RQK2R w K -"));
-	items.push_back(BenchItem("r2q1rk1/1bppbppp/p4n2/n2Np3/Pp2P3/1B1P1N2/1PP2PPP/R1BQ1RK1 w - -"));
-	items.push_back(BenchItem("rnb2rk1/1pq1bppp/p3pn2/3p4/3NPP2/2N1B3/PPP1B1PP/R3QRK1 w - -"));
-	items.push_back(BenchItem("2rq1rk1/p3bppp/bpn1pn2/2pp4/3P4/1P2PNP1/PBPN1PBP/R2QR1K1 w - -"));
-	items.push_back(BenchItem("rn3rk1/1p2ppbp/1pp3p1/3n4/3P1Bb1/2N1PN2/PP3PPP/2R1KB1R w K -"));
-	items.push_back(BenchItem("r1bq1rk1/3nbppp/p1p1pn2/1p4B1/3P4/2NBPN2/PP3PPP/2RQK2R w K -"));
-	items.push_back(BenchItem("r3kbnr/1bpq2pp/p2p1p2/1p2p3/3PP2N/1PN5/1PP2PPP/R1BQ1RK1 w kq -"));
-	items.push_back(BenchItem("r1b1k2r/pp1nqp1p/2p3p1/3p3n/3P4/2NBP3/PPQ2PPP/2KR2NR w kq -"));
-	items.push_back(BenchItem("r2q1rk1/1b2ppbp/ppnp1np1/2p5/P3P3/2PP1NP1/1P1N1PBP/R1BQR1K1 w - -"));
-	items.push_back(BenchItem("r2q1rk1/pp2ppbp/2n1bnp1/3p4/4PPP1/1NN1B3/PPP1B2P/R2QK2R w KQ -"));
-	items.push_back(BenchItem("r1bq1rk1/bpp2ppp/p2p1nn1/4p3/4P3/1BPP1NN1/PP3PPP/R1BQ1RK1 w - -"));
-	items.push_back(BenchItem("rn3rk1/pbppqpp1/1p2p2p/8/2PP4/2Q1PN2/PP3PPP/R3KB1R w KQ -"));
-	items.push_back(BenchItem("r2q1rk1/p1p2ppp/2p1pb2/3n1b2/3P4/P4N1P/1PP2PP1/RNBQ1RK1 w - -"));
-	items.push_back(BenchItem("rnb2rk1/p4ppp/1p2pn2/q1p5/2BP4/P1P1PN2/1B3PPP/R2QK2R w KQ -"));
-	items.push_back(BenchItem("r2q1rk1/1p1bbppp/p1nppn2/8/3NPP2/2N1B3/PPPQB1PP/R4RK1 w - -"));
-	items.push_back(BenchItem("r2q1rk1/3nbppp/bpp1pn2/p1Pp4/1P1P1B2/P1N1PN1P/5PP1/R2QKB1R w KQ -"));
-	items.push_back(BenchItem("r1b1r1k1/pp1nqppp/2pbpn2/8/2pP4/2N1PN1P/PPQ1BPP1/R1BR2K1 w - -"));
-	items.push_back(BenchItem("r3kbnr/1bqp1ppp/p3p3/1p2P3/5P2/2N2B2/PPP3PP/R1BQK2R w KQkq -"));
-	items.push_back(BenchItem("r2q1rk1/pb1n1ppp/1p1ppn2/2p3B1/2PP4/P1Q2P2/1P1NP1PP/R3KB1R w KQ -"));
-	items.push_back(BenchItem("r1bq1rk1/pp1n1ppp/4p3/2bpP3/3n1P2/2N1B3/PPPQ2PP/2KR1B1R w - -"));
-	items.push_back(BenchItem("r2q1rk1/ppp1bppp/2n1b3/3np3/8/P1NPBNP1/1P2PPBP/R2Q1RK1 w - -"));
-	items.push_back(BenchItem("2q1r1k1/1ppb4/r2p1Pp1/p4n1p/2P1n3/5NPP/PP3Q1K/2BRRB2 w - -"));
-	items.push_back(BenchItem("7r/1p2k3/2bpp3/p3np2/P1PR4/2N2PP1/1P4K1/3B4 b - -"));
-	items.push_back(BenchItem("4k3/p1P3p1/2q1np1p/3N4/8/1Q3PP1/6KP/8 w - -"));
-	items.push_back(BenchItem("2r1b1k1/R4pp1/4pb1p/1pBr4/1Pq2P2/3N4/2PQ2PP/5RK1 b - -"));
-	items.push_back(BenchItem("6k1/p1qb1p1p/1p3np1/2b2p2/2B5/2P3N1/PP2QPPP/4N1K1 b - -"));
-	items.push_back(BenchItem("3q4/pp3pkp/5npN/2bpr1B1/4r3/2P2Q2/PP3PPP/R4RK1 w - -"));
-	items.push_back(BenchItem("3rr1k1/pb3pp1/1p1q1b1p/1P2NQ2/3P4/P1NB4/3K1P1P/2R3R1 w - -"));
-	items.push_back(BenchItem("r1b1r1k1/p1p3pp/2p2n2/2bp4/5P2/3BBQPq/PPPK3P/R4N1R b - -"));
-	items.push_back(BenchItem("3r4/1b2k3/1pq1pp2/p3n1pr/2P5/5PPN/PP1N1QP1/R2R2K1 b - -"));
-	items.push_back(BenchItem("2r4k/pB4bp/6p1/6q1/1P1n4/2N5/P4PPP/2R1Q1K1 b - -"));
-	items.push_back(BenchItem("1r5r/3b1pk1/3p1np1/p1qPp3/p1N1PbP1/2P2PN1/1PB1Q1K1/R3R3 b - -"));
-	items.push_back(BenchItem("5rk1/7p/p1N5/3pNp2/2bPnqpQ/P7/1P3PPP/4R1K1 w - -"));
-	items.push_back(BenchItem("rnb2rk1/pp2np1p/2p2q1b/8/2BPPN2/2P2Q2/PP4PP/R1B2RK1 w - -"));
-	items.push_back(BenchItem("2k4r/1pp2ppp/p1p1bn2/4N3/1q1rP3/2N1Q3/PPP2PPP/R4RK1 w - -"));
-	items.push_back(BenchItem("r3kb1r/pp2pppp/3q4/3Pn3/6b1/2N1BN2/PP3PPP/R2QKB1R w KQkq -"));
-	items.push_back(BenchItem("2rr2k1/1b3p1p/p4qpb/2R1n3/3p4/BP2P3/P3QPPP/3R1BKN b - -"));
-	items.push_back(BenchItem("r1b1k3/5p1p/p1p5/3np3/1b2N3/4B3/PPP1BPrP/2KR3R w q -"));
-	items.push_back(BenchItem("r3rbk1/1pq2ppp/2ppbnn1/p3p3/P1PPN3/BP1BPN1P/2Q2PP1/R2R2K1 w - -"));
-	items.push_back(BenchItem("b7/2q2kp1/p3pbr1/1pPpP2Q/1P1N3P/6P1/P7/5RK1 w - -"));
-	items.push_back(BenchItem("1rr1nbk1/5ppp/3p4/1q1PpN2/np2P3/5Q1P/P1BB1PP1/2R1R1K1 w - -"));
-	items.push_back(BenchItem("r7/5kp1/2p1p2p/1p1n3P/2rP4/2P3R1/PK2RPP1/2B5 b - -"));
-	items.push_back(BenchItem("1N2k3/5p2/p2P2p1/3Pp3/pP3b2/5P1r/P7/1K4R1 b - -"));
-	items.push_back(BenchItem("2k2R2/6r1/8/B2pp2p/1p6/3P4/PP2b3/2K5 b - -"));
-	items.push_back(BenchItem("2k5/1pp5/2pb2p1/7p/6n1/P5N1/1PP3PP/2K1B3 b - -"));
-	items.push_back(BenchItem("2n5/1k6/3pNn2/3ppp2/7p/4P2P/1P4P1/5NK1 w - -"));
-	items.push_back(BenchItem("5nk1/B4p2/7p/6p1/3N3n/2r2PK1/5P1P/4R3 b - -"));
-	items.push_back(BenchItem("8/1p3pkp/p1r3p1/3P3n/3p1P2/3P4/PP3KP1/R3N3 b - -"));
-	items.push_back(BenchItem("8/2B2k2/p2p2pp/2pP1p2/2P2P2/2b1N1PP/P4K2/2n5 b - -"));
-	items.push_back(BenchItem("8/4p1kp/1n1p2p1/nPp5/b5P1/P5KP/3N1P2/4NB2 w - -"));
-	items.push_back(BenchItem("r1b3k1/2p4p/3p1p2/1p1P4/1P3P2/P5P1/5KNP/R7 b - -"));
-	items.push_back(BenchItem("1k2b3/1pp5/4r3/R3N1pp/1P3P2/p5P1/2P4P/1K6 w - -"));
-	items.push_back(BenchItem("1r2b3/p3p1kp/1p4p1/2pPP3/P1P1B3/R7/3K2PP/8 w - -"));
-	items.push_back(BenchItem("1r6/5ppk/R6p/P3p3/1Pn5/6P1/2p2P1P/2B4K w - -"));
-	items.push_back(BenchItem("2k5/3n1pb1/p2n2pp/2pP4/2P2PP1/1K3N1P/2B5/4B3 w - -"));
-	items.push_back(BenchItem("2n5/7r/1p1k4/2nP1p2/4P3/P3KP1P/3R4/5B2 w - -"));
-	items.push_back(BenchItem("3b3k/5p2/1n1P4/p1p1P2p/P1p5/2P4b/3N2N1/3B3K b - -"));
-	items.push_back(BenchItem("3k4/2p3pp/3p1b2/3P3P/b7/P3BB2/1P3P2/2K5 w - -"));
-	items.push_back(BenchItem("3R1bk1/7p/1p2P1p1/3P4/pP6/P2N2P1/4p1KP/5r2 b - -"));
-	items.push_back(BenchItem("3rn3/p4p2/1p3k2/6pp/2PpB3/P2K2P1/1P4PP/4R3 b - -"));
-	items.push_back(BenchItem("4n3/2k1b3/p6p/P5p1/2K2pP1/5B1P/5P2/4B3 w - -"));
-	items.push_back(BenchItem("4n3/p5k1/2P3pp/2P5/P3pp2/2K3P1/5r1P/R4N2 w - -"));
-	items.push_back(BenchItem("6k1/p7/6pp/1p1Pp3/2n1P1Pb/6NP/P4KP1/B7 w - -"));
+// every position is searched to a small depth from an empty hash; the status
+// is the number of positions where the mating move was not played
+int Benchmark::mateTest() const
+{
+	const int depthLimit = Search::depth_limit;
+	int failed = 0;
 
-	auto it = items.begin();
+	Search::depth_limit = 4;
 
-	const Clock timer = Clock::startNow();
-	while (it != items.end())
+	for (const auto& [fen, mate] : matePositions)
+	{
+		position.loadFen(fen);
+		Search::clearHash();
+		Eval::cache.Clear();
+
+		const std::string move = Search::startThinking(SearchType::Infinite, position, false).toAlgebraic();
+
+		if (move != mate)
+			failed++;
+		std::cout << "Fen: " << fen << std::endl;
+		std::cout << "Move played: " << move << ", mate: " << mate << (move == mate ? "" : ", failed") << std::endl;
+		std::cout << std::endl;
+	}
+	Search::depth_limit = depthLimit;
+	position.loadFen(startPosition);
+	return failed;
+}
+
+// the bench set, searched in this order
+static const char* const benchPositions[] =
+{
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -",
+	"r1bn1rk1/ppp1qppp/3pp3/3P4/2P1n3/2B2NP1/PP2PPBP/2RQK2R w K -",
+	"r2q1rk1/1bppbppp/p4n2/n2Np3/Pp2P3/1B1P1N2/1PP2PPP/R1BQ1RK1 w - -",
+	"rnb2rk1/1pq1bppp/p3pn2/3p4/3NPP2/2N1B3/PPP1B1PP/R3QRK1 w - -",
+	"2rq1rk1/p3bppp/bpn1pn2/2pp4/3P4/1P2PNP1/PBPN1PBP/R2QR1K1 w - -",
+	"rn3rk1/1p2ppbp/1pp3p1/3n4/3P1Bb1/2N1PN2/PP3PPP/2R1KB1R w K -",
+	"r1bq1rk1/3nbppp/p1p1pn2/1p4B1/3P4/2NBPN2/PP3PPP/2RQK2R w K -",
+	"r3kbnr/1bpq2pp/p2p1p2/1p2p3/3PP2N/1PN5/1PP2PPP/R1BQ1RK1 w kq -",
+	"r1b1k2r/pp1nqp1p/2p3p1/3p3n/3P4/2NBP3/PPQ2PPP/2KR2NR w kq -",
+	"r2q1rk1/1b2ppbp/ppnp1np1/2p5/P3P3/2PP1NP1/1P1N1PBP/R1BQR1K1 w - -",
+	"r2q1rk1/pp2ppbp/2n1bnp1/3p4/4PPP1/1NN1B3/PPP1B2P/R2QK2R w KQ -",
+	"r1bq1rk1/bpp2ppp/p2p1nn1/4p3/4P3/1BPP1NN1/PP3PPP/R1BQ1RK1 w - -",
+	"rn3rk1/pbppqpp1/1p2p2p/8/2PP4/2Q1PN2/PP3PPP/R3KB1R w KQ -",
+	"r2q1rk1/p1p2ppp/2p1pb2/3n1b2/3P4/P4N1P/1PP2PP1/RNBQ1RK1 w - -",
+	"rnb2rk1/p4ppp/1p2pn2/q1p5/2BP4/P1P1PN2/1B3PPP/R2QK2R w KQ -",
+	"r2q1rk1/1p1bbppp/p1nppn2/8/3NPP2/2N1B3/PPPQB1PP/R4RK1 w - -",
+	"r2q1rk1/3nbppp/bpp1pn2/p1Pp4/1P1P1B2/P1N1PN1P/5PP1/R2QKB1R w KQ -",
+	"r1b1r1k1/pp1nqppp/2pbpn2/8/2pP4/2N1PN1P/PPQ1BPP1/R1BR2K1 w - -",
+	"r3kbnr/1bqp1ppp/p3p3/1p2P3/5P2/2N2B2/PPP3PP/R1BQK2R w KQkq -",
+	"r2q1rk1/pb1n1ppp/1p1ppn2/2p3B1/2PP4/P1Q2P2/1P1NP1PP/R3KB1R w KQ -",
+	"r1bq1rk1/pp1n1ppp/4p3/2bpP3/3n1P2/2N1B3/PPPQ2PP/2KR1B1R w - -",
+	"r2q1rk1/ppp1bppp/2n1b3/3np3/8/P1NPBNP1/1P2PPBP/R2Q1RK1 w - -",
+	"2q1r1k1/1ppb4/r2p1Pp1/p4n1p/2P1n3/5NPP/PP3Q1K/2BRRB2 w - -",
+	"7r/1p2k3/2bpp3/p3np2/P1PR4/2N2PP1/1P4K1/3B4 b - -",
+	"4k3/p1P3p1/2q1np1p/3N4/8/1Q3PP1/6KP/8 w - -",
+	"2r1b1k1/R4pp1/4pb1p/1pBr4/1Pq2P2/3N4/2PQ2PP/5RK1 b - -",
+	"6k1/p1qb1p1p/1p3np1/2b2p2/2B5/2P3N1/PP2QPPP/4N1K1 b - -",
+	"3q4/pp3pkp/5npN/2bpr1B1/4r3/2P2Q2/PP3PPP/R4RK1 w - -",
+	"3rr1k1/pb3pp1/1p1q1b1p/1P2NQ2/3P4/P1NB4/3K1P1P/2R3R1 w - -",
+	"r1b1r1k1/p1p3pp/2p2n2/2bp4/5P2/3BBQPq/PPPK3P/R4N1R b - -",
+	"3r4/1b2k3/1pq1pp2/p3n1pr/2P5/5PPN/PP1N1QP1/R2R2K1 b - -",
+	"2r4k/pB4bp/6p1/6q1/1P1n4/2N5/P4PPP/2R1Q1K1 b - -",
+	"1r5r/3b1pk1/3p1np1/p1qPp3/p1N1PbP1/2P2PN1/1PB1Q1K1/R3R3 b - -",
+	"5rk1/7p/p1N5/3pNp2/2bPnqpQ/P7/1P3PPP/4R1K1 w - -",
+	"rnb2rk1/pp2np1p/2p2q1b/8/2BPPN2/2P2Q2/PP4PP/R1B2RK1 w - -",
+	"2k4r/1pp2ppp/p1p1bn2/4N3/1q1rP3/2N1Q3/PPP2PPP/R4RK1 w - -",
+	"r3kb1r/pp2pppp/3q4/3Pn3/6b1/2N1BN2/PP3PPP/R2QKB1R w KQkq -",
+	"2rr2k1/1b3p1p/p4qpb/2R1n3/3p4/BP2P3/P3QPPP/3R1BKN b - -",
+	"r1b1k3/5p1p/p1p5/3np3/1b2N3/4B3/PPP1BPrP/2KR3R w q -",
+	"r3rbk1/1pq2ppp/2ppbnn1/p3p3/P1PPN3/BP1BPN1P/2Q2PP1/R2R2K1 w - -",
+	"b7/2q2kp1/p3pbr1/1pPpP2Q/1P1N3P/6P1/P7/5RK1 w - -",
+	"1rr1nbk1/5ppp/3p4/1q1PpN2/np2P3/5Q1P/P1BB1PP1/2R1R1K1 w - -",
+	"r7/5kp1/2p1p2p/1p1n3P/2rP4/2P3R1/PK2RPP1/2B5 b - -",
+	"1N2k3/5p2/p2P2p1/3Pp3/pP3b2/5P1r/P7/1K4R1 b - -",
+	"2k2R2/6r1/8/B2pp2p/1p6/3P4/PP2b3/2K5 b - -",
+	"2k5/1pp5/2pb2p1/7p/6n1/P5N1/1PP3PP/2K1B3 b - -",
+	"2n5/1k6/3pNn2/3ppp2/7p/4P2P/1P4P1/5NK1 w - -",
+	"5nk1/B4p2/7p/6p1/3N3n/2r2PK1/5P1P/4R3 b - -",
+	"8/1p3pkp/p1r3p1/3P3n/3p1P2/3P4/PP3KP1/R3N3 b - -",
+	"8/2B2k2/p2p2pp/2pP1p2/2P2P2/2b1N1PP/P4K2/2n5 b - -",
+	"8/4p1kp/1n1p2p1/nPp5/b5P1/P5KP/3N1P2/4NB2 w - -",
+	"r1b3k1/2p4p/3p1p2/1p1P4/1P3P2/P5P1/5KNP/R7 b - -",
+	"1k2b3/1pp5/4r3/R3N1pp/1P3P2/p5P1/2P4P/1K6 w - -",
+	"1r2b3/p3p1kp/1p4p1/2pPP3/P1P1B3/R7/3K2PP/8 w - -",
+	"1r6/5ppk/R6p/P3p3/1Pn5/6P1/2p2P1P/2B4K w - -",
+	"2k5/3n1pb1/p2n2pp/2pP4/2P2PP1/1K3N1P/2B5/4B3 w - -",
+	"2n5/7r/1p1k4/2nP1p2/4P3/P3KP1P/3R4/5B2 w - -",
+	"3b3k/5p2/1n1P4/p1p1P2p/P1p5/2P4b/3N2N1/3B3K b - -",
+	"3k4/2p3pp/3p1b2/3P3P/b7/P3BB2/1P3P2/2K5 w - -",
+	"3R1bk1/7p/1p2P1p1/3P4/pP6/P2N2P1/4p1KP/5r2 b - -",
+	"3rn3/p4p2/1p3k2/6pp/2PpB3/P2K2P1/1P4PP/4R3 b - -",
+	"4n3/2k1b3/p6p/P5p1/2K2pP1/5B1P/5P2/4B3 w - -",
+	"4n3/p5k1/2P3pp/2P5/P3pp2/2K3P1/5r1P/R4N2 w - -",
+	"6k1/p7/6pp/1p1Pp3/2n1P1Pb/6NP/P4KP1/B7 w - -",
+};
+
+struct BenchResult
+{
+	uint64_t Nodes;
+	double Time;
+	uint64_t HashProbes;
+	uint64_t HashHits;
+	std::string BestMove;
+};
+
+static uint64_t perSecond(const uint64_t nodes, const double milliseconds)
+{
+	return milliseconds > 0 ? static_cast<uint64_t>(nodes * 1000 / milliseconds) : 0;
+}
+
+static uint64_t perMill(const uint64_t part, const uint64_t whole)
+{
+	return whole ? part * 1000 / whole : 0;
+}
+
+// nodes and nps by position number from a csv written by an earlier bench,
+// with the totals row under index 0
+static bool readBaseline(const std::string& fileName, std::vector<std::pair<uint64_t, uint64_t>>& rows)
+{
+	std::ifstream file(fileName);
+	std::string line;
+
+	if (!file || !std::getline(file, line))
+		return false;
+
+	rows.assign(std::size(benchPositions) + 1, {0, 0});
+
+	while (std::getline(file, line))
 	{
-		if (Search::stopSignal)
+		std::istringstream stream(line);
+		std::string field[5];
+
+		for (auto& f : field)
+			std::getline(stream, f, ',');
+
+		const size_t index = field[0] == "total" ? 0 : std::strtoul(field[0].c_str(), nullptr, 10);
+
+		if (index < rows.size())
+			rows[index] = {std::strtoull(field[2].c_str(), nullptr, 10), std::strtoull(field[4].c_str(), nullptr, 10)};
+	}
+	return true;
+}
+
+// every position is searched to the same depth on the calling thread alone,
+// whatever the Threads option, from an empty hash, so the node total is a
+// signature of the search. the results go
+// to bench_<date and time>.csv, one row per position and a totals row; with a
+// baseline csv, positions whose nps dropped by more than threshold percent are
+// flagged. the status is non zero if a search came back without a move, if
+// the baseline cannot be read, or if a position was flagged
+int Benchmark::runBench(const int depth, const std::string& baseline, const int threshold) const
+{
+	const int depthLimit = Search::depth_limit;
+	std::vector<BenchResult> results;
+	BenchResult total{};
+	int failed = 0;
+
+	std::vector<std::pair<uint64_t, uint64_t>> rows;
+
+	// read before searching, so a missing baseline does not cost a whole bench
+	if (!baseline.empty() && !readBaseline(baseline, rows))
+	{
+		std::cout << "cannot read baseline " << baseline << std::endl;
+		return 1;
+	}
+
+	// lazy smp helpers would make the node counts vary from run to run
+	const int threads = Search::cores;
+	Search::initThreads(1);
+	Search::depth_limit = depth;
+
+	for (const auto fen : benchPositions)
+	{
+		position.loadFen(fen);
+		Search::clearHash();
+		Eval::cache.Clear();
+
+		const Clock timer = Clock::startNow();
+		const Move move = Search::startThinking(SearchType::Infinite, position, false);
+		BenchResult result{Search::totalNodes(), timer.elapsedMicroseconds() / 1000, 0, 0, move.toAlgebraic()};
+		Search::totalHashStats(result.HashProbes, result.HashHits);
+
+		if (move.isNull())
 		{
-			const vecBenchItems::value_type& item = *it++;
-			position.loadFen(item.fen);
-			position.Display();
-			Uci::search = std::thread(Search::startThinking, type, std::ref(position), true);
-			Uci::search.detach();
-			Search::Hash.Clear();
+			failed++;
+			result.BestMove = "(none)";
 		}
-		Sleep(500);
-	}
-	const double elapsedTime = timer.elapsedMilliseconds() / 1000;
 
-	Sleep(2000);
+		total.Nodes += result.Nodes;
+		total.Time += result.Time;
+		total.HashProbes += result.HashProbes;
+		total.HashHits += result.HashHits;
+		results.push_back(result);
+
+		std::cout << "position " << results.size() << ": nodes " << result.Nodes
+			<< " time " << static_cast<uint64_t>(result.Time) << " ms nps " << perSecond(result.Nodes, result.Time)
+			<< " hash " << perMill(result.HashHits, result.HashProbes) << " permill bestmove " << result.BestMove << std::endl;
+	}
+	Search::depth_limit = depthLimit;
+	Search::initThreads(threads);
+	position.loadFen(startPosition);
 
+	const uint64_t nps = perSecond(total.Nodes, total.Time);
+	std::cout << std::endl;
 	std::cout << "Depth: " << depth << std::endl;
+	std::cout << "Nodes: " << total.Nodes << std::endl;
 	std::ostringstream t;
 	t.precision(3);
-	t << "Time: " << std::fixed << elapsedTime << " secs" << std::endl;
+	t << "Time : " << std::fixed << total.Time / 1000 << " secs" << std::endl;
 	std::cout << t.str();
+	std::cout << "Speed: " << nps << " nps" << std::endl;
+	std::cout << "Hash : " << perMill(total.HashHits, total.HashProbes) << " permill hits" << std::endl;
 
+	char buf[32];
+	char fileName[64];
 	const time_t now = time(nullptr);
-	strftime(buf, 32, "%b-%d_%H-%M", localtime(&now));
-	sprintf(fileName, "bench_%s.txt", buf);
-	printf("results written to:\n");
-	printf("benchmark_%s.txt\n\n", buf);
-	benchLog = fopen(fileName, "wt");
-	fprintf(benchLog, "" ENGINE " " VERSION " " PLATFORM "\n");
-	fprintf(benchLog, "TTD bench\n\n");
-	fprintf(benchLog, "Depth: %d\n", depth);
-	fprintf(benchLog, "Time: %.2f secs\n", elapsedTime);
-	fclose(benchLog);
+	strftime(buf, sizeof buf, "%Y-%b-%d_%H-%M-%S", localtime(&now));
+	snprintf(fileName, sizeof fileName, "bench_%s.csv", buf);
 
-	position.loadFen(startPosition);
+	// never overwrite an earlier run, which may be the baseline itself
+	if (std::ifstream(fileName))
+		std::cout << fileName << " exists, results not written" << std::endl;
+	else if (std::ofstream csv(fileName); csv)
+	{
+		csv << "position,depth,nodes,time_ms,nps,hash_probes,hash_hits,hash_permill,bestmove,fen" << std::endl;
+		csv.precision(3);
+		csv << std::fixed;
+
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const BenchResult& r = results[i];
+			csv << i + 1 << "," << depth << "," << r.Nodes << "," << r.Time << "," << perSecond(r.Nodes, r.Time)
+				<< "," << r.HashProbes << "," << r.HashHits << "," << perMill(r.HashHits, r.HashProbes)
+				<< "," << r.BestMove << "," << benchPositions[i] << std::endl;
+		}
+		csv << "total," << depth << "," << total.Nodes << "," << total.Time << "," << nps
+			<< "," << total.HashProbes << "," << total.HashHits << "," << perMill(total.HashHits, total.HashProbes)
+			<< ",," << std::endl;
+		std::cout << "results written to " << fileName << std::endl;
+	}
+
+	if (baseline.empty())
+		return failed ? 1 : 0;
+
+	std::cout << std::endl << "baseline " << baseline << ", threshold " << threshold << "%" << std::endl;
+	int regressions = 0;
+
+	// index 0 is the totals row
+	for (size_t i = 0; i <= results.size(); i++)
+	{
+		const BenchResult& r = i ? results[i - 1] : total;
+		const uint64_t current = perSecond(r.Nodes, r.Time);
+		const auto [baseNodes, baseNps] = rows[i];
+		const std::string name = i ? "position " + std::to_string(i) : "total";
+
+		if (baseNodes && baseNodes != r.Nodes)
+			std::cout << name << ": nodes " << r.Nodes << " vs " << baseNodes << ", search changed" << std::endl;
+
+		if (baseNps && current * 100 < baseNps * (100 - threshold))
+		{
+			regressions++;
+			std::cout << name << ": nps " << current << " vs " << baseNps << " ("
+				<< (static_cast<int64_t>(current) - static_cast<int64_t>(baseNps)) * 100 / static_cast<int64_t>(baseNps)
+				<< "%), regression" << std::endl;
+		}
+	}
+	std::cout << regressions << " regressions" << std::endl;
+	return failed || regressions ? 1 : 0;
 }
@@ -1,19 +1,28 @@
 #pragma once
+#include <cstdint>
+#include <string>
+#include "perfttable.h"
 
 class Pos;
+class Move;
 
 class Benchmark
 {
 public:
-	explicit Benchmark(Pos&);
+	static constexpr int perftHash = 16;
+	static constexpr int benchThreshold = 10;
+	explicit Benchmark(Pos&, int = perftHash);
 	void runPerft(int);
 	uint64_t Perft(int);
 	void runDivide(int);
 	uint64_t Divide(int);
-	uint64_t Loop(int);
 	void perftTest();
-	void ttdTest(int) const;
+	int mateTest() const;
+	int runBench(int, const std::string& = "", int = benchThreshold) const;
 
 private:
 	Pos& position;
+	std::unique_ptr<PerftTable> table;
+	int splitRoot(int, Move[], uint64_t[]);
+	static uint64_t Perft(Pos&, int, PerftTable*);
 };
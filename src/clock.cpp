@@ -15,6 +15,11 @@ double Clock::elapsedMilliseconds() const
 	return static_cast<double>(std::chrono::duration_cast<MS>(t_clock::now() - begin).count());
 }
 
+double Clock::elapsedMicroseconds() const
+{
+	return static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(t_clock::now() - begin).count());
+}
+
 Clock Clock::startNow()
 {
 	Clock watch;
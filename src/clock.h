@@ -10,6 +10,7 @@ public:
 	Clock() noexcept;
 	void Restart();
 	double elapsedMilliseconds() const;
+	double elapsedMicroseconds() const;
 	static Clock startNow();
 
 private:
@@ -0,0 +1,108 @@
+#include "cpu.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPUID
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define CPUID
+#endif
+
+namespace
+{
+#ifdef CPUID
+	struct Registers
+	{
+		unsigned Eax, Ebx, Ecx, Edx;
+	};
+
+	Registers cpuid(const unsigned leaf, const unsigned subLeaf = 0)
+	{
+		Registers r{};
+#ifdef _MSC_VER
+		int regs[4];
+		__cpuidex(regs, static_cast<int>(leaf), static_cast<int>(subLeaf));
+		r = { static_cast<unsigned>(regs[0]), static_cast<unsigned>(regs[1]),
+			static_cast<unsigned>(regs[2]), static_cast<unsigned>(regs[3]) };
+#else
+		__cpuid_count(leaf, subLeaf, r.Eax, r.Ebx, r.Ecx, r.Edx);
+#endif
+		return r;
+	}
+
+	// register state the operating system saves on a context switch
+	unsigned long long xgetbv()
+	{
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned lo, hi;
+		__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+		return static_cast<unsigned long long>(hi) << 32 | lo;
+#endif
+	}
+#endif
+
+	Cpu::Features detect()
+	{
+		Cpu::Features f;
+#ifdef CPUID
+		const Registers vendor = cpuid(0);
+		const unsigned maxLeaf = vendor.Eax;
+
+		if (maxLeaf < 1)
+			return f;
+
+		const Registers basic = cpuid(1);
+		const Registers extended = maxLeaf >= 7 ? cpuid(7) : Registers{};
+		const Registers extended1 = extended.Eax >= 1 ? cpuid(7, 1) : Registers{};
+		const bool osxsave = basic.Ecx >> 27 & 1;
+		const unsigned long long xcr0 = osxsave ? xgetbv() : 0;
+		const bool avxState = (xcr0 & 0x06) == 0x06;
+		const bool avx512State = (xcr0 & 0xe6) == 0xe6;
+
+		f.Sse41 = basic.Ecx >> 19 & 1;
+		f.Avx2 = avxState && (basic.Ecx >> 28 & 1) && (extended.Ebx >> 5 & 1);
+		f.Avx512 = avx512State && (extended.Ebx >> 16 & 1) && (extended.Ebx >> 30 & 1);
+		f.AvxVnni = f.Avx2 && (extended1.Eax >> 4 & 1);
+		f.Avx512Vnni = f.Avx512 && (extended.Ebx >> 31 & 1) && (extended.Ecx >> 11 & 1);
+		f.Bmi2 = extended.Ebx >> 8 & 1;
+
+		// "AuthenticAMD", and family 0x17 (zen 1 and 2) or older, where pext is
+		// done in microcode and is slower than the magic multiplications
+		const bool amd = vendor.Ebx == 0x68747541 && vendor.Edx == 0x69746e65 && vendor.Ecx == 0x444d4163;
+		unsigned family = basic.Eax >> 8 & 0xf;
+		if (family == 0xf)
+			family += basic.Eax >> 20 & 0xff;
+		f.FastPext = f.Bmi2 && !(amd && family < 0x19);
+#endif
+		return f;
+	}
+}
+
+const Cpu::Features& Cpu::features()
+{
+	static const Features f = detect();
+	return f;
+}
+
+std::string Cpu::describe()
+{
+	const Features& f = features();
+	std::string s;
+
+	if (f.Avx512)
+		s += " avx512";
+	if (f.Avx512Vnni)
+		s += " avx512vnni";
+	if (f.Avx2)
+		s += " avx2";
+	if (f.AvxVnni)
+		s += " avxvnni";
+	if (f.Sse41)
+		s += " sse4.1";
+	if (f.Bmi2)
+		s += f.FastPext ? " bmi2" : " bmi2(slow pext)";
+
+	return s.empty() ? "none" : s.substr(1);
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+
+// instruction set extensions of the cpu the engine runs on, read once with
+// cpuid, so that one binary can pick its fastest code paths at startup
+namespace Cpu
+{
+	struct Features
+	{
+		bool Sse41 = false;
+		bool Avx2 = false;
+		bool Avx512 = false; // avx512f and avx512bw
+		bool AvxVnni = false; // vex encoded dot products of bytes on avx2
+		bool Avx512Vnni = false; // avx512 with vnni and vl
+		bool Bmi2 = false;
+		bool FastPext = false; // bmi2 without the microcoded pext of amd before zen 3
+	};
+
+	const Features& features();
+	std::string describe();
+}
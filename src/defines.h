@@ -8,15 +8,10 @@ using Score = std::pair<int, int>;
 #define ENGINE "Napoleon"
 #define VERSION "2.0"
 #define AUTHOR "Marco Pampaloni"
-
-//#define PEXT
+#define NNUE_FILE "nn.bin"
 
 #ifdef _WIN64
-#ifdef PEXT
-#define PLATFORM "x64 pext"
-#else
 #define PLATFORM "x64"
-#endif
 #else
 #define PLATFORM "w32"
 #endif
@@ -26,9 +21,7 @@ using Score = std::pair<int, int>;
 #ifdef __GNUC__
 #define INLINE __inline __attribute__ ((__always_inline__))
 #elif defined(_MSC_VER) && defined(_WIN64)
-#ifdef PEXT
 #include <immintrin.h>
-#endif
 #include <intrin.h>
 #define INLINE __forceinline
 #else
@@ -123,6 +116,26 @@ INLINE int popcount(uint64_t bitBoard)
 #endif
 }
 
+// issued with inline assembly (the intrinsic under msvc) rather than through
+// -mbmi2, so that a binary built for any x86-64 can use it once the cpu is
+// known to have it: see Cpu::features()
+INLINE uint64_t pext(const uint64_t bitBoard, const uint64_t mask)
+{
+#if defined(__GNUC__) && defined(__x86_64__)
+	uint64_t result;
+	__asm__("pextq %2, %1, %0" : "=r"(result) : "r"(bitBoard), "rm"(mask));
+	return result;
+#elif defined(_MSC_VER) && defined(_WIN64)
+	return _pext_u64(bitBoard, mask);
+#else
+	uint64_t result = 0;
+	for (uint64_t bit = 1, m = mask; m; m &= m - 1, bit <<= 1)
+		if (bitBoard & m & -m)
+			result |= bit;
+	return result;
+#endif
+}
+
 INLINE bool isBitSet(const uint64_t bitBoard, const int bitPos)
 {
 	return (bitBoard & static_cast<uint64_t>(1) << bitPos) != 0;
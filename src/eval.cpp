@@ -32,85 +32,21 @@ noColor
 *     bking=7, bqueen=8, brook=9, bbishop=10, bknight=11, bpawn=12,
 */
 
+thread_local EvalCache Eval::cache;
+std::atomic<int> Eval::cacheSize(EvalCache::defaultSize);
+
 int Eval::evaluate(const Pos& pos)
 {
-	int pieces[33]{};
-	int squares[33]{};
-	int index = 2;
-	for (uint8_t i = 0; i < 64; i++)
-	{
-		if (pos.pieceOnSquare(i).Color == White && pos.pieceOnSquare(i).Type == King)
-		{
-			pieces[0] = 1;
-			squares[0] = i;
-		}
-		else if (pos.pieceOnSquare(i).Color == Black && pos.pieceOnSquare(i).Type == King)
-		{
-			pieces[1] = 7;
-			squares[1] = i;
-		}
-		else if (pos.pieceOnSquare(i).Color == White && pos.pieceOnSquare(i).Type == Pawn)
-		{
-			pieces[index] = 6;
-			squares[index] = i;
-			index++;
-		}
-		else if (pos.pieceOnSquare(i).Color == Black && pos.pieceOnSquare(i).Type == Pawn)
-		{
-			pieces[index] = 12;
-			squares[index] = i;
-			index++;
-		}
-		else if (pos.pieceOnSquare(i).Color == White && pos.pieceOnSquare(i).Type == Knight)
-		{
-			pieces[index] = 5;
-			squares[index] = i;
-			index++;
-		}
-		else if (pos.pieceOnSquare(i).Color == Black && pos.pieceOnSquare(i).Type == Knight)
-		{
-			pieces[index] = 11;
-			squares[index] = i;
-			index++;
-		}
-		else if (pos.pieceOnSquare(i).Color == White && pos.pieceOnSquare(i).Type == Bishop)
-		{
-			pieces[index] = 4;
-			squares[index] = i;
-			index++;
-		}
-		else if (pos.pieceOnSquare(i).Color == Black && pos.pieceOnSquare(i).Type == Bishop)
-		{
-			pieces[index] = 10;
-			squares[index] = i;
-			index++;
-		}
-		else if (pos.pieceOnSquare(i).Color == White && pos.pieceOnSquare(i).Type == Rook)
-		{
-			pieces[index] = 3;
-			squares[index] = i;
-			index++;
-		}
-		else if (pos.pieceOnSquare(i).Color == Black && pos.pieceOnSquare(i).Type == Rook)
-		{
-			pieces[index] = 9;
-			squares[index] = i;
-			index++;
-		}
-		else if (pos.pieceOnSquare(i).Color == White && pos.pieceOnSquare(i).Type == Queen)
-		{
-			pieces[index] = 2;
-			squares[index] = i;
-			index++;
-		}
-		else if (pos.pieceOnSquare(i).Color == Black && pos.pieceOnSquare(i).Type == Queen)
-		{
-			pieces[index] = 8;
-			squares[index] = i;
-			index++;
-		}
-	}
-	const int nnue_score = nnue_evaluate(pos.getSideToMove(), pieces, squares);
+	int score;
+
+	if (cache.Probe(pos.zobrist, score))
+		return score;
+
+	int plies;
+	NNUEdata* nnue = pos.getNnueData(plies);
+	const int nnue_score = nnue_evaluate_lazy(pos.getSideToMove(),
+		const_cast<int*>(pos.nnuePieces()), const_cast<int*>(pos.nnueSquares()), nnue, plies);
+	cache.Save(pos.zobrist, nnue_score);
 	return nnue_score;
 }
 
@@ -1,8 +1,10 @@
 #pragma once
+#include <atomic>
 #include "defines.h"
 #include "position.h"
 #include "piece.h"
 #include "pst.h"
+#include "evalcache.h"
 
 class pieceInfo;
 
@@ -12,6 +14,8 @@ namespace Eval
 	int evaluateHCE(const Pos& position);
 	Score pieceSquareScore(pieceInfo, uint8_t);
 	void updateScore(Score&, int, int);
+	extern thread_local EvalCache cache;
+	extern std::atomic<int> cacheSize; // set by the uci thread, read by the searchers
 }
 
 INLINE void Eval::updateScore(Score& scores, const int openingBonus, const int endBonus)
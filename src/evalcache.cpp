@@ -0,0 +1,37 @@
+#include <algorithm>
+#include "evalcache.h"
+
+EvalCache::EvalCache(const int size)
+{
+	setSize(size);
+}
+
+// size in MB, rounded down to a power of two number of entries
+void EvalCache::setSize(int mb)
+{
+	mb = std::clamp(mb, minSize, maxSize);
+
+	if (mb == sizeMb)
+		return;
+
+	uint64_t entries = 1;
+	while (entries * 2 * sizeof(Entry) <= static_cast<uint64_t>(mb) << 20)
+		entries *= 2;
+
+	table.assign(entries, Entry{});
+	mask = entries - 1;
+	sizeMb = mb;
+	resetStats();
+}
+
+void EvalCache::Clear()
+{
+	std::fill(table.begin(), table.end(), Entry{});
+	resetStats();
+}
+
+void EvalCache::resetStats()
+{
+	hits = 0;
+	probes = 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+#include "defines.h"
+
+class EvalCache
+{
+public:
+	static constexpr int defaultSize = 4;
+	static constexpr int minSize = 1;
+	static constexpr int maxSize = 256;
+	explicit EvalCache(int size = defaultSize);
+	void setSize(int);
+	void Clear();
+	void resetStats();
+	bool Probe(uint64_t, int&);
+	void Save(uint64_t, int);
+	uint64_t Hits() const;
+	uint64_t Probes() const;
+
+private:
+	struct Entry
+	{
+		uint64_t Key;
+		int Score;
+	};
+
+	std::vector<Entry> table;
+	uint64_t mask{};
+	uint64_t hits{};
+	uint64_t probes{};
+	int sizeMb{};
+};
+
+INLINE bool EvalCache::Probe(const uint64_t key, int& score)
+{
+	const Entry& entry = table[key & mask];
+	++probes;
+
+	if (entry.Key != key)
+		return false;
+
+	++hits;
+	score = entry.Score;
+	return true;
+}
+
+INLINE void EvalCache::Save(const uint64_t key, const int score)
+{
+	Entry& entry = table[key & mask];
+	entry.Key = key;
+	entry.Score = score;
+}
+
+inline uint64_t EvalCache::Hits() const
+{
+	return hits;
+}
+
+inline uint64_t EvalCache::Probes() const
+{
+	return probes;
+}
@@ -3,12 +3,12 @@
 HashEntry::HashEntry() noexcept
 = default;
 
-HashEntry::HashEntry(const uint64_t hash, const uint8_t depth, const int score, const Move bestMove,
-	const ScoreType bound)
+HashEntry::HashEntry(const uint8_t depth, const int score, const Move bestMove, const ScoreType bound,
+	const uint8_t generation)
 {
-	Key = hash;
 	Depth = depth;
 	Score = score;
 	Bound = bound;
 	BestMove = bestMove;
+	Generation = generation;
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include "move.h"
 
 enum class ScoreType : uint8_t
@@ -11,11 +12,92 @@ enum class ScoreType : uint8_t
 class HashEntry
 {
 public:
-	uint64_t Key{};
 	uint8_t Depth{};
 	ScoreType Bound{};
 	Move BestMove;
 	int Score{};
+	uint8_t Generation{};
 	HashEntry() noexcept;
-	HashEntry(uint64_t, uint8_t, int, Move, ScoreType);
+	HashEntry(uint8_t, int, Move, ScoreType, uint8_t);
+	uint64_t Pack(uint64_t) const;
+	static HashEntry Unpack(uint64_t);
 };
+
+// lock-free slot: the whole entry, including the key fragment it is checked
+// against, is one 64-bit word, so a concurrent Store can never tear it
+class HashSlot
+{
+public:
+	bool Load(uint64_t, HashEntry&) const;
+	void Store(uint64_t, const HashEntry&);
+	uint8_t Depth() const;
+	uint8_t Generation() const;
+	bool Matches(uint64_t) const;
+	void Refresh(uint64_t, uint8_t);
+
+private:
+	std::atomic<uint64_t> data;
+};
+
+// packed entry: key (16) | score (16) | best move (16) | depth (8) | generation (6) | bound (2)
+inline uint64_t HashEntry::Pack(const uint64_t key) const
+{
+	return (key & 0xffff000000000000ULL)
+		| static_cast<uint64_t>(static_cast<uint16_t>(Score)) << 32
+		| static_cast<uint64_t>(BestMove.Raw()) << 16
+		| static_cast<uint64_t>(Depth) << 8
+		| static_cast<uint64_t>(Generation) << 2
+		| static_cast<uint64_t>(Bound);
+}
+
+inline HashEntry HashEntry::Unpack(const uint64_t data)
+{
+	return HashEntry(static_cast<uint8_t>(data >> 8), static_cast<int16_t>(data >> 32),
+		Move(static_cast<uint16_t>(data >> 16)), static_cast<ScoreType>(data & 0x3),
+		static_cast<uint8_t>((data >> 2) & 0x3f));
+}
+
+inline bool HashSlot::Load(const uint64_t key, HashEntry& entry) const
+{
+	const uint64_t d = data.load(std::memory_order_relaxed);
+
+	if (!d || (d ^ key) >> 48)
+		return false;
+
+	entry = HashEntry::Unpack(d);
+	return true;
+}
+
+inline bool HashSlot::Matches(const uint64_t key) const
+{
+	const uint64_t d = data.load(std::memory_order_relaxed);
+	return d && !((d ^ key) >> 48);
+}
+
+inline void HashSlot::Store(const uint64_t key, const HashEntry& entry)
+{
+	data.store(entry.Pack(key), std::memory_order_relaxed);
+}
+
+inline uint8_t HashSlot::Depth() const
+{
+	return static_cast<uint8_t>(data.load(std::memory_order_relaxed) >> 8);
+}
+
+inline uint8_t HashSlot::Generation() const
+{
+	return static_cast<uint8_t>((data.load(std::memory_order_relaxed) >> 2) & 0x3f);
+}
+
+// moves the entry of key to the current generation. a slot rewritten by
+// another thread in the meantime is left alone
+inline void HashSlot::Refresh(const uint64_t key, const uint8_t generation)
+{
+	uint64_t d = data.load(std::memory_order_relaxed);
+
+	if (!d || (d ^ key) >> 48 || ((d >> 2) & 0x3f) == generation)
+		return;
+
+	data.compare_exchange_strong(d, (d & ~(0x3fULL << 2)) | static_cast<uint64_t>(generation) << 2,
+		std::memory_order_relaxed);
+}
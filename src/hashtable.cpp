@@ -1,95 +1,217 @@
 #include "hashtable.h"
 #include "searchinfo.h"
+#include <algorithm>
 #include <valarray>
+#include <iostream>
+#include <fstream>
+#include <string>
+#ifdef __linux__
+#include <sys/mman.h>
+#elif defined(_WIN32)
+#include <malloc.h>
+#endif
 
 hashTable::hashTable(const int size) noexcept
 {
-	setSize(size);
+	if (size > 0)
+	{
+		setSize(size);
+		Clear();
+	}
 }
 
+// a size that cannot be allocated keeps the previous one, halved further
+// if even that fails. the new table is left untouched for Search::clearHash
+// to zero, so its pages are first touched by the threads that search it
 void hashTable::setSize(int mb)
 {
 	mb = static_cast<int>(std::pow(2, static_cast<int>(Log2(mb))));
 
-	entries = static_cast<uint32_t>((mb * std::pow(2, 20)) / sizeof(HashEntry));
-	lockEntries = (entries / bucketSize);
+	const uint32_t previous = clusters;
+	clusters = static_cast<uint32_t>((mb * std::pow(2, 20)) / sizeof(HashCluster));
+
+	release();
+
+	if (!allocate(clusters * sizeof(HashCluster)))
+	{
+		clusters = previous ? previous : clusters / 2;
+
+		while (!allocate(clusters * sizeof(HashCluster)) && clusters > 1)
+			clusters /= 2;
+
+		// not even one huge page: a single static bucket keeps probes valid
+		if (!table)
+		{
+			table = &spare;
+			clusters = 1;
+			pages = "one static bucket";
+		}
+
+		std::cout << "info string could not allocate " << mb << " MB for the hash table, using "
+			<< clusters * sizeof(HashCluster) / (1024 * 1024) << " MB" << std::endl;
+	}
 
+	std::cout << "info string hash table uses " << pages << std::endl;
+	mask = clusters - 1;
+}
+
+#ifdef __linux__
+// madvise succeeds even when transparent huge pages are turned off, only
+// the setting tells whether the kernel will back the table with them
+static bool transparentHugePages()
+{
+	static const bool enabled = []
+	{
+		std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+		std::string setting;
+		std::getline(file, setting);
+		return setting.find("[always]") != std::string::npos || setting.find("[madvise]") != std::string::npos;
+	}();
+	return enabled;
+}
+#endif
+
+// 2 MB aligned so the table can be backed by huge pages: explicit hugetlb
+// pages when the system has some reserved, transparent ones otherwise
+bool hashTable::allocate(const size_t size)
+{
+	allocated = (size + hugePageSize - 1) / hugePageSize * hugePageSize;
+	void* mem;
+
+#ifdef __linux__
+	mem = mmap(nullptr, allocated, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	mapped = mem != MAP_FAILED;
+
+	if (mapped)
+		pages = "hugetlb 2MB pages";
+	else
+	{
+		mem = std::aligned_alloc(hugePageSize, allocated);
+		pages = mem && madvise(mem, allocated, MADV_HUGEPAGE) == 0 && transparentHugePages()
+			? "transparent huge pages"
+			: "4KB pages";
+	}
+#elif defined(_WIN32)
+	mem = _aligned_malloc(allocated, hugePageSize);
+	pages = "4KB pages";
+#else
+	mem = std::aligned_alloc(hugePageSize, allocated);
+	pages = "default pages";
+#endif
+
+	table = static_cast<HashCluster*>(mem);
+	return table != nullptr;
+}
+
+void hashTable::release()
+{
+	if (!table || table == &spare)
+	{
+		table = nullptr;
+		return;
+	}
+
+#ifdef __linux__
+	if (mapped)
+		munmap(table, allocated);
+	else
+		free(table);
+#elif defined(_WIN32)
+	_aligned_free(table);
+#else
 	free(table);
-	free(locks);
-	table = static_cast<HashEntry*>(std::calloc(entries * sizeof(HashEntry), 1));
-	locks = new SpinLock[lockEntries];
-	mask = entries - bucketSize;
+#endif
+
+	table = nullptr;
 }
 
-void hashTable::Save(const uint64_t key, const uint8_t depth, const int score, const Move move,
+void hashTable::Save(const uint64_t key, const uint8_t depth, const int score, Move move,
 	const ScoreType bound) const
 {
-	const auto mux = locks + (key & mask) / bucketSize;
-	std::lock_guard<SpinLock> lock(*mux);
-	int min = maxPly;
-	int index = 0;
 	auto hash = at(key);
+	auto replace = hash;
+	HashEntry entry;
 
+	// same position or an empty slot first, otherwise the slot that is
+	// shallowest once older generations are discounted
 	for (auto i = 0; i < bucketSize; i++, hash++)
 	{
-		if (hash->Depth < min)
+		if (hash->Matches(key) || !hash->Depth())
 		{
-			min = hash->Depth;
-			index = i;
+			replace = hash;
+			break;
 		}
+
+		if (hash->Depth() - 8 * Age(hash) < replace->Depth() - 8 * Age(replace))
+			replace = hash;
 	}
 
-	if (depth >= min)
+	if (replace->Load(key, entry))
 	{
-		const auto hashToOverride = at(key, index);
-		hashToOverride->Key = key;
-		hashToOverride->Score = score;
-		hashToOverride->Depth = depth;
-		hashToOverride->Bound = bound;
-		hashToOverride->BestMove = move;
+		if (bound != ScoreType::Exact && depth + 4 <= entry.Depth && !Age(replace))
+			return;
+		if (move.isNull())
+			move = entry.BestMove;
 	}
+	else if (depth < replace->Depth() && !Age(replace))
+		return;
+
+	replace->Store(key, HashEntry(depth, score, move, bound, Generation()));
 }
 
 std::pair<int, Move> hashTable::Probe(const uint64_t key, const uint8_t depth, int alpha, int beta) const
 {
-	const auto mux = locks + (key & mask) / bucketSize;
-	std::lock_guard<SpinLock> lock(*mux);
 	auto hash = at(key);
 	auto move = nullMove;
+	HashEntry entry;
 
 	for (auto i = 0; i < bucketSize; i++, hash++)
 	{
-		if (hash->Key == key)
+		if (hash->Load(key, entry))
 		{
-			if (hash->Depth >= depth)
+			// still in use, so not aged out by the replacement in Save
+			if (const uint8_t current = Generation(); entry.Generation != current)
+				hash->Refresh(key, current);
+
+			if (entry.Depth >= depth)
 			{
-				if (hash->Bound == ScoreType::Exact)
-					return std::make_pair(hash->Score, move);
-				if (hash->Bound == ScoreType::Alpha && hash->Score <= alpha)
+				if (entry.Bound == ScoreType::Exact)
+					return std::make_pair(entry.Score, move);
+				if (entry.Bound == ScoreType::Alpha && entry.Score <= alpha)
 					return std::make_pair(alpha, move);
-				if (hash->Bound == ScoreType::Beta && hash->Score >= beta)
+				if (entry.Bound == ScoreType::Beta && entry.Score >= beta)
 					return std::make_pair(beta, move);
 			}
-			move = hash->BestMove;
+			move = entry.BestMove;
 		}
 	}
 	return std::make_pair(Unknown, move);
 }
 
-void hashTable::Clear() const
+// zeroes one of count equal slices of the table; Search::clearHash has
+// each search thread zero its own slice
+void hashTable::Clear(const int slice, const int count)
 {
-	memset(table, 0, entries * sizeof(HashEntry));
+	const size_t size = (clusters + count - 1) / count;
+	const size_t start = std::min(slice * size, static_cast<size_t>(clusters));
+	const size_t end = std::min(start + size, static_cast<size_t>(clusters));
+	memset(table + start, 0, (end - start) * sizeof(HashCluster));
+
+	if (slice == 0)
+		generation = 0;
 }
 
 Move hashTable::getPV(const uint64_t key) const
 {
 	auto hash = at(key);
+	HashEntry entry;
+
 	for (auto i = 0; i < bucketSize; i++, hash++)
 	{
-		if (hash->Key == key)
+		if (hash->Load(key, entry))
 		{
-			if (!hash->BestMove.isNull())
-				return hash->BestMove;
+			if (!entry.BestMove.isNull())
+				return entry.BestMove;
 		}
 	}
 	return nullMove;
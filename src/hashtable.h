@@ -1,52 +1,82 @@
 #pragma once
-#include <mutex>
 #include <atomic>
 #include <valarray>
 #include "hashentry.h"
+#ifndef NO_PREFETCH
+#include <xmmintrin.h>
+#endif
 
-class SpinLock
+// one cache line per bucket
+struct alignas(64) HashCluster
 {
-public:
-	INLINE void lock()
-	{
-		while (spinLock.test_and_set(std::memory_order_acquire))
-		{
-		}
-	}
-
-	INLINE void unlock()
-	{
-		spinLock.clear(std::memory_order_release);
-	}
-
-private:
-	std::atomic_flag spinLock = ATOMIC_FLAG_INIT;
+	HashSlot Slot[8];
 };
 
 class hashTable
 {
 public:
 	static constexpr int Unknown = -999999;
-	static constexpr int bucketSize = 4;
-	explicit hashTable(int size = 32) noexcept;
+	static constexpr int bucketSize = 8;
+	explicit hashTable(int size = 0) noexcept;
 	void setSize(int);
 	void Save(uint64_t, uint8_t, int, Move, ScoreType) const;
-	void Clear() const;
+	void Clear(int = 0, int = 1);
+	int Size() const;
+	void newSearch();
 	std::pair<int, Move> Probe(uint64_t, uint8_t, int, int) const;
 	Move getPV(uint64_t) const;
+	void prefetch(uint64_t) const;
 
 private:
+	static constexpr size_t hugePageSize = 2 * 1024 * 1024;
 	uint64_t mask{};
-	uint32_t entries{};
-	uint32_t lockEntries{};
-	HashEntry* table{};
-	SpinLock* locks{};
-	HashEntry* at(uint64_t, int = 0) const;
+	uint32_t clusters{};
+	std::atomic<uint8_t> generation{}; // bumped by analysis workers while others search, 6 bits used
+	HashCluster* table{};
+	size_t allocated{};
+	bool mapped{};
+	const char* pages{};
+	HashCluster spare{};
+	bool allocate(size_t);
+	void release();
+	HashSlot* at(uint64_t, int = 0) const;
+	int Age(const HashSlot*) const;
+	uint8_t Generation() const;
 };
 
-inline HashEntry* hashTable::at(const uint64_t key, const int index) const
+inline HashSlot* hashTable::at(const uint64_t key, const int index) const
+{
+	return table[key & mask].Slot + index;
+}
+
+// searches since the slot was last written, modulo the 6-bit generation
+inline int hashTable::Age(const HashSlot* slot) const
+{
+	return (Generation() - slot->Generation()) & 0x3f;
+}
+
+inline uint8_t hashTable::Generation() const
+{
+	return generation.load(std::memory_order_relaxed) & 0x3f;
+}
+
+inline void hashTable::prefetch([[maybe_unused]] const uint64_t key) const
+{
+#ifndef NO_PREFETCH
+	_mm_prefetch(reinterpret_cast<const char*>(table + (key & mask)), _MM_HINT_T0);
+#endif
+}
+
+// megabytes actually allocated, after any fallback in setSize
+inline int hashTable::Size() const
+{
+	return static_cast<int>(static_cast<size_t>(clusters) * sizeof(HashCluster) / (1024 * 1024));
+}
+
+inline void hashTable::newSearch()
 {
-	return table + (key & mask) + index;
+	// the counter wraps at 256, a multiple of 64, so masking it on read is exact
+	generation.fetch_add(1, std::memory_order_relaxed);
 }
 
 inline double Log2(const double x)
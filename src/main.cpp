@@ -1,12 +1,46 @@
+#include <string>
+#include "cpu.h"
 #include "search.h"
+#include "zobrist.h"
 #include "nnue-probe/nnue.h"
 
-int main()
+int main(const int argc, char* argv[])
 {
+	Moves::initAttacks();
+	Zobrist::Init();
 	Uci::engineInfo();
-	Search::Hash.setSize(32);
 	Search::initThreads();
-	nnue_init("nn.bin");
+	Search::setHashSize(32);
+	nnue_init(NNUE_FILE);
+	std::cout << "info string cpu " << Cpu::describe() << ", nnue " << nnue_kernels() << " kernels, "
+		<< (Moves::usePext ? "pext" : "magic") << " slider attacks" << std::endl;
+
+	// napoleon bench|analyze|evaluate|writecache|verifycache|matetest [arguments of the command]: run it and exit with its status
+	const std::string command = argc > 1 ? argv[1] : "";
+	if (command == "bench" || command == "analyze" || command == "evaluate" || command == "writecache"
+		|| command == "verifycache" || command == "matetest")
+	{
+		std::string args;
+		for (auto i = 2; i < argc; i++)
+			args += std::string(argv[i]) + " ";
+
+		std::istringstream stream(args);
+		Uci::position.loadFen();
+		const int status = command == "bench"
+			? Uci::Bench(stream)
+			: command == "analyze"
+			? Uci::Analyze(stream)
+			: command == "evaluate"
+			? Uci::Evaluate(stream)
+			: command == "verifycache"
+			? Uci::VerifyCache()
+			: command == "matetest"
+			? Uci::MateTest()
+			: Uci::WriteCache();
+		Search::killThreads();
+		return status;
+	}
+
 	Uci::Start();
 	return 0;
 }
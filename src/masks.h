@@ -57,17 +57,4 @@ namespace Masks
 		0x0000010204081020, 0x0001020408102040, 0x0102040810204080, 0x0204081020408000, 0x0408102040800000,
 		0x0810204080000000, 0x1020408000000000, 0x2040800000000000, 0x4080000000000000, 0x8000000000000000
 	};
-#ifdef PEXT
-	const uint64_t sixBitA1H8diagMask[] =
-	{
-	0x0, 0x0, 0x4000, 0x402000, 0x40201000, 0x4020100800, 0x402010080400, 0x40201008040200,
-	0x20100804020000, 0x10080402000000, 0x8040200000000, 0x4020000000000, 0x2000000000000, 0x0, 0x0
-	};
-
-	const uint64_t sixBitH1A8DdiagMask[] =
-	{
-	0x0, 0x0, 0x200, 0x20400, 0x2040800, 0x204081000, 0x20408102000, 0x2040810204000,
-	0x4081020400000, 0x8102040000000, 0x10204000000000, 0x20400000000000, 0x40000000000000, 0x0, 0x0
-	};
-#endif
 }
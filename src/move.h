@@ -21,12 +21,14 @@ public:
 	Move() noexcept;
 	Move(uint8_t, uint8_t);
 	Move(uint8_t, uint8_t, uint8_t);
+	explicit Move(uint16_t);
 
 	uint8_t fromSquare() const;
 	uint8_t toSquare() const;
 	uint8_t piecePromoted() const;
 
 	int butterflyIndex() const;
+	uint16_t Raw() const;
 
 	bool isNull() const;
 	bool isCastle() const;
@@ -60,6 +62,10 @@ INLINE Move::Move(const uint8_t from, const uint8_t to, const uint8_t flag)
 	move = (from & 0x3f) | ((to & 0x3f) << 6) | ((flag & 0xf) << 12);
 }
 
+INLINE Move::Move(const uint16_t raw) : move(raw)
+{
+}
+
 INLINE uint8_t Move::fromSquare() const
 {
 	return move & 0x3f;
@@ -75,6 +81,11 @@ INLINE int Move::butterflyIndex() const
 	return (move & 0xfff);
 }
 
+INLINE uint16_t Move::Raw() const
+{
+	return move;
+}
+
 INLINE uint8_t Move::piecePromoted() const
 {
 	if (!isPromotion())
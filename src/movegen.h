@@ -13,6 +13,8 @@ namespace moveGen
 	template <bool>
 	void getPseudoLegalMoves(Move allMoves[], int& pos, uint64_t attackers, Pos& position);
 	void getLegalMoves(Move allMoves[], int& pos, Pos& position);
+	bool isLegal(Move, Pos& position);
+	bool isPseudoLegal(Move, const Pos& position);
 	void getAllMoves(Move allMoves[], int& pos, Pos& position);
 
 	template <bool>
@@ -43,20 +45,11 @@ template <bool onlyCaptures>
 INLINE void moveGen::getPseudoLegalMoves(Move allMoves[], int& pos, const uint64_t attackers, Pos& position)
 {
 	if (attackers)
-	{
 		getEvadeMoves<onlyCaptures>(position, attackers, allMoves, pos);
-		position.setCheckState(true);
-	}
 	else if (onlyCaptures)
-	{
 		getCaptures(allMoves, pos, position);
-		position.setCheckState(false);
-	}
 	else
-	{
 		getAllMoves(allMoves, pos, position);
-		position.setCheckState(false);
-	}
 }
 
 INLINE void moveGen::getAllMoves(Move allMoves[], int& pos, Pos& position)
@@ -206,7 +199,7 @@ INLINE void moveGen::getCastleMoves(const Pos& position, Move moveList[], int& p
 		{
 			if ((Castle::whiteCastleMaskOOO & position.occupiedSquares) == 0)
 			{
-				if (!position.isAttacked(Castle::whiteCastleMaskOOO ^ Masks::squareMask[8], position.getSideToMove()))
+				if (!position.isAttacked(Castle::whiteCastleMaskOOO ^ Masks::squareMask[Square::B1], position.getSideToMove()))
 					moveList[pos++] = Castle::whiteCastlingOOO;
 			}
 		}
@@ -226,7 +219,7 @@ INLINE void moveGen::getCastleMoves(const Pos& position, Move moveList[], int& p
 		{
 			if ((Castle::blackCastleMaskOOO & position.occupiedSquares) == 0)
 			{
-				if (!position.isAttacked(Castle::blackCastleMaskOOO ^ Masks::squareMask[15], position.getSideToMove()))
+				if (!position.isAttacked(Castle::blackCastleMaskOOO ^ Masks::squareMask[Square::B8], position.getSideToMove()))
 					moveList[pos++] = Castle::blackCastlingOOO;
 			}
 		}
@@ -264,14 +257,7 @@ void moveGen::getEvadeMoves(Pos& position, const uint64_t attackers, Move moveLi
 				sliderAttacks |= Moves::pseudoBishopAttacks[checksq] | Moves::pseudoRookAttacks[checksq];
 
 			else
-
-#ifdef PEXT
 				sliderAttacks |= Moves::pseudoBishopAttacks[checksq] | Moves::getRookAttacks(position.occupiedSquares, checksq);
-#else
-				sliderAttacks |= Moves::pseudoBishopAttacks[checksq] | (Moves::getRankAttacks(
-					position.occupiedSquares, checksq)
-					| Moves::getFileAttacks(position.occupiedSquares, checksq));
-#endif
 
 			break;
 
@@ -310,23 +296,64 @@ void moveGen::getEvadeMoves(Pos& position, const uint64_t attackers, Move moveLi
 	getQueenMoves(position.Pieces(position.getSideToMove(), Queen), position, moveList, pos, target);
 }
 
+// only legal moves: checkers and pins are found once, the king is kept off
+// attacked squares, a single check restricts the other pieces to capturing
+// or blocking, and just the moves of pinned pieces and en passant are tested.
+// used at the root, for evasions and by perft; other nodes keep the staged
+// pseudo-legal moves of MovePick, tested one by one as they are searched
 INLINE void moveGen::getLegalMoves(Move allMoves[], int& pos, Pos& position)
 {
-	const uint64_t pinned = position.pinnedPieces();
-	const uint64_t attackers = position.kingAttackers(position.getKingSquare(position.getSideToMove()),
-		position.getSideToMove());
+	const uint8_t side = position.getSideToMove();
+	const uint8_t enemy = Piece::getOpposite(side);
+	const uint8_t ksq = position.getKingSquare(side);
+	const uint64_t checkers = position.kingAttackers(ksq, side);
+	const uint64_t own = position.ourPieces();
 
-	if (attackers)
-		getEvadeMoves<false>(position, attackers, allMoves, pos);
+	// the king is lifted so a checking slider still covers the squares behind it
+	const uint64_t occupied = position.occupiedSquares ^ Masks::squareMask[ksq];
+	uint64_t kingTargets = Moves::kingAttacks[ksq] & ~own;
+
+	while (kingTargets)
+	{
+		const uint8_t to = BSFReset(kingTargets);
+
+		if (!position.attacksTo(to, enemy, occupied))
+			allMoves[pos++] = Move(ksq, to);
+	}
+
+	if (checkers & (checkers - 1))
+		return;
+
+	uint64_t target = ~own;
+
+	if (checkers)
+		target = Moves::obstructedTable[BSF(checkers)][ksq] | checkers;
 	else
-		getAllMoves(allMoves, pos, position);
+		getCastleMoves(position, allMoves, pos);
+
+	const uint64_t pinned = position.pinnedPieces();
+	const int first = pos;
+
+	getPawnMoves<true>(position.Pieces(side, Pawn), position, allMoves, pos, target);
+	getKnightMoves(position.Pieces(side, Knight) & ~pinned, position, allMoves, pos, target);
+	getBishopMoves(position.Pieces(side, Bishop), position, allMoves, pos, target);
+	getRookMoves(position.Pieces(side, Rook), position, allMoves, pos, target);
+	getQueenMoves(position.Pieces(side, Queen), position, allMoves, pos, target);
+
+	if (!pinned && position.getPassantSquare() == Square::noSquare)
+		return;
 
 	int last = pos;
-	int cur = 0;
+	int cur = first;
 
 	while (cur != last)
 	{
-		if (!position.isMoveLegal(allMoves[cur], pinned))
+		const Move move = allMoves[cur];
+
+		if (move.isEnPassant()
+			? !position.isEnPassantLegal(move)
+			: (pinned & Masks::squareMask[move.fromSquare()])
+			&& !Moves::AreSquaresAligned(move.fromSquare(), move.toSquare(), ksq))
 		{
 			allMoves[cur] = allMoves[--last];
 		}
@@ -337,3 +364,69 @@ INLINE void moveGen::getLegalMoves(Move allMoves[], int& pos, Pos& position)
 	}
 	pos = last;
 }
+
+// whether the generator would produce this move in a position that is not
+// in check, so hash and killer moves can be tried before generating
+INLINE bool moveGen::isPseudoLegal(const Move move, const Pos& position)
+{
+	const uint8_t side = position.getSideToMove();
+	const uint8_t from = move.fromSquare();
+	const uint8_t to = move.toSquare();
+	const uint64_t target = Masks::squareMask[to];
+	const pieceInfo piece = position.pieceOnSquare(from);
+
+	if (move.isNull() || piece.Color != side || (position.Pieces(side) & target))
+		return false;
+
+	if (move.isCastle())
+	{
+		Move castles[2];
+		int count = 0;
+		getCastleMoves(position, castles, count);
+		return (count > 0 && castles[0] == move) || (count > 1 && castles[1] == move);
+	}
+
+	if (piece.Type == Pawn)
+	{
+		if (move.isEnPassant())
+			return to == position.getPassantSquare() && (Moves::pawnAttacks[side][from] & target);
+
+		if (move.isPromotion() != ((target & (Ranks::One | Ranks::Eight)) != 0)
+			|| (move.Raw() >> 12) > queenPromotion
+			|| (!move.isPromotion() && (move.Raw() >> 12)))
+			return false;
+
+		return (Pawn::getAllTargets(Masks::squareMask[from], position) & target) != 0;
+	}
+
+	if (move.Raw() >> 12)
+		return false;
+
+	switch (piece.Type)
+	{
+	case Knight:
+		return (Moves::knightAttacks[from] & target) != 0;
+	case Bishop:
+		return (Bishop::targetsFrom(from, side, position) & target) != 0;
+	case Rook:
+		return (Rook::targetsFrom(from, side, position) & target) != 0;
+	case Queen:
+		return (Queen::targetsFrom(from, side, position) & target) != 0;
+	case King:
+		return (Moves::kingAttacks[from] & target) != 0;
+	default:
+		return false;
+	}
+}
+
+INLINE bool moveGen::isLegal(const Move move, Pos& position)
+{
+	int count = 0;
+	Move moves[maxMoves];
+	getLegalMoves(moves, count, position);
+
+	for (auto i = 0; i < count; i++)
+		if (moves[i] == move)
+			return true;
+	return false;
+}
@@ -1,9 +1,24 @@
 #pragma once
+#include <climits>
 #include "movegen.h"
 
 class MovePick
 {
 public:
+	// staged order for nodes not in check; All is the generate-everything
+	// order still used at the root, in quiescence and for evasions
+	enum class Stage
+	{
+		HashMove,
+		GenCaptures,
+		GoodCaptures,
+		Killers,
+		BadCaptures,
+		GenQuiets,
+		Quiets,
+		All
+	};
+
 	Pos& position;
 	Move moves[moveGen::maxMoves];
 	Move hashMove;
@@ -12,15 +27,27 @@ public:
 
 	template <bool>
 	void Sort(int = 0);
+	void Staged(Move, int);
 	Move First();
 	Move Next();
 	void Reset();
 	Move& operator [](int);
 
 private:
-	int scores[moveGen::maxMoves]{};
+	int scores[moveGen::maxMoves];
+	Move badCaptures[moveGen::maxMoves];
 	SearchInfo& info;
 	int first;
+	int killerPly{};
+	int killer{};
+	int badCount{};
+	int badIndex{};
+	Move killers[2];
+	Stage stage{Stage::All};
+	void sortMoves(int, int);
+	void generateCaptures();
+	void generateQuiets();
+	Move nextStaged();
 };
 
 inline Move& MovePick::operator [](const int index)
@@ -30,8 +57,17 @@ inline Move& MovePick::operator [](const int index)
 
 inline Move MovePick::First()
 {
+	if (stage != Stage::All)
+		return nextStaged();
+
+	// the hash move is only matched on a key fragment, so it must be one of ours
 	if (!hashMove.isNull())
-		return hashMove;
+	{
+		for (auto i = 0; i < count; i++)
+			if (moves[i] == hashMove)
+				return hashMove;
+		hashMove = nullMove;
+	}
 	return Next();
 }
 
@@ -40,26 +76,43 @@ inline void MovePick::Reset()
 	first = 0;
 }
 
+// insertion sorts the moves from begin on with a score of at least limit to the
+// front, best first; the rest follow in generation order
+inline void MovePick::sortMoves(const int begin, const int limit)
+{
+	for (int sorted = begin - 1, p = begin; p < count; p++)
+	{
+		if (scores[p] < limit)
+			continue;
+
+		const Move move = moves[p];
+		const int score = scores[p];
+		int q = ++sorted;
+
+		moves[p] = moves[q];
+		scores[p] = scores[q];
+
+		for (; q > begin && scores[q - 1] < score; q--)
+		{
+			moves[q] = moves[q - 1];
+			scores[q] = scores[q - 1];
+		}
+		moves[q] = move;
+		scores[q] = score;
+	}
+}
+
 inline Move MovePick::Next()
 {
+	if (stage != Stage::All)
+		return nextStaged();
+
 	if (first == -1)
 		return First();
 
-	int max = first;
-
-	if (max >= count)
+	if (first >= count)
 		return nullMove;
 
-	for (auto i = first + 1; i < count; i++)
-		if (scores[i] > scores[max])
-			max = i;
-
-	if (max != first)
-	{
-		std::swap(moves[first], moves[max]);
-		std::swap(scores[first], scores[max]);
-	}
-
 	const Move move = moves[first++];
 
 	if (move != hashMove)
@@ -70,43 +123,184 @@ inline Move MovePick::Next()
 template <bool quiesce>
 void MovePick::Sort(const int ply)
 {
+	const uint8_t side = position.getSideToMove();
+	const Move firstKiller = info.firstKiller(ply);
+	const Move secondKiller = info.secondKiller(ply);
+	bool quiet[moveGen::maxMoves];
 	int max = 0;
-	int historyScore;
 
 	for (auto i = 0; i < count; i++)
 	{
-		if (moves[i].isPromotion())
+		const Move move = moves[i];
+		quiet[i] = !position.isCapture(move) && move != firstKiller && move != secondKiller;
+
+		// history is looked up once; quiet promotions rank by it too but stay out of the maximum
+		if (quiet[i])
 		{
-			scores[i] = pieceValue[moves[i].piecePromoted()];
+			scores[i] = info.historyScore(move, side);
+
+			if (!move.isPromotion() && scores[i] > max)
+				max = scores[i];
+		}
+		else if (move.isPromotion())
+		{
+			scores[i] = pieceValue[move.piecePromoted()];
 		}
-		else if (position.isCapture(moves[i]))
+		else if (position.isCapture(move))
 		{
 			if (quiesce)
 			{
-				const uint8_t captured = moves[i].isEnPassant()
+				const uint8_t captured = move.isEnPassant()
 					? static_cast<uint8_t>(Pawn)
-					: position.pieceOnSquare(moves[i].toSquare()).Type;
-				scores[i] = pieceValue[captured] - pieceValue[position.pieceOnSquare(moves[i].fromSquare()).Type];
+					: position.pieceOnSquare(move.toSquare()).Type;
+				scores[i] = pieceValue[captured] - pieceValue[position.pieceOnSquare(move.fromSquare()).Type];
 			}
 			else
 			{
-				scores[i] = position.See(moves[i]);
+				scores[i] = position.See(move);
 			}
 		}
+		else
+		{
+			scores[i] = move == firstKiller ? -1 : -2;
+		}
+	}
+
+	for (auto i = 0; i < count; i++)
+		if (quiet[i])
+			scores[i] -= max + 3;
+
+	sortMoves(0, INT_MIN);
+}
+
+inline void MovePick::Staged(const Move move, const int ply)
+{
+	hashMove = move;
+	killerPly = ply;
+	stage = Stage::HashMove;
+}
 
-		else if (moves[i] == info.firstKiller(ply))
-			scores[i] = -1;
+// captures and promotions, scored by victim and attacker (mvv/lva)
+inline void MovePick::generateCaptures()
+{
+	const uint8_t side = position.getSideToMove();
+	const uint64_t promoting = position.Pieces(side, Pawn) & (side == White ? Ranks::Seven : Ranks::Two);
 
-		else if (moves[i] == info.secondKiller(ply))
-			scores[i] = -2;
+	moveGen::getCaptures(moves, count, position);
+	moveGen::getPawnMoves<false>(promoting, position, moves, count, position.emptySquares);
 
-		else if ((historyScore = info.historyScore(moves[i], position.getSideToMove())) > max)
-			max = historyScore;
+	for (auto i = first; i < count; i++)
+	{
+		const uint8_t captured = moves[i].isEnPassant()
+			? static_cast<uint8_t>(Pawn)
+			: position.pieceOnSquare(moves[i].toSquare()).Type;
+		const int victim = captured == noType ? 0 : pieceValue[captured];
+
+		if (moves[i].isPromotion())
+			scores[i] = pieceValue[moves[i].piecePromoted()] + victim;
+		else
+			scores[i] = victim * 8 - pieceValue[position.pieceOnSquare(moves[i].fromSquare()).Type];
 	}
+}
 
-	for (auto i = 0; i < count; i++)
+// everything else, with promotions already generated with the captures
+inline void MovePick::generateQuiets()
+{
+	const uint8_t side = position.getSideToMove();
+	const uint64_t target = position.emptySquares;
+	const uint64_t pawns = position.Pieces(side, Pawn) & ~(side == White ? Ranks::Seven : Ranks::Two);
+	const int start = count;
+
+	moveGen::getPawnMoves<false>(pawns, position, moves, count, target);
+	moveGen::getKnightMoves(position.Pieces(side, Knight), position, moves, count, target);
+	moveGen::getBishopMoves(position.Pieces(side, Bishop), position, moves, count, target);
+	moveGen::getQueenMoves(position.Pieces(side, Queen), position, moves, count, target);
+	moveGen::getKingMoves(position.Pieces(side, King), position, moves, count, target);
+	moveGen::getRookMoves(position.Pieces(side, Rook), position, moves, count, target);
+	moveGen::getCastleMoves(position, moves, count);
+
+	for (auto i = start; i < count; i++)
+		scores[i] = info.historyScore(moves[i], side);
+}
+
+inline Move MovePick::nextStaged()
+{
+	switch (stage)
 	{
-		if (!position.isCapture(moves[i]) && moves[i] != info.firstKiller(ply) && moves[i] != info.secondKiller(ply))
-			scores[i] = info.historyScore(moves[i], position.getSideToMove()) - max - 3;
+	case Stage::HashMove:
+		stage = Stage::GenCaptures;
+
+		if (moveGen::isPseudoLegal(hashMove, position))
+			return hashMove;
+		hashMove = nullMove;
+		[[fallthrough]];
+
+	case Stage::GenCaptures:
+		generateCaptures();
+		sortMoves(first, INT_MIN);
+		stage = Stage::GoodCaptures;
+		[[fallthrough]];
+
+	case Stage::GoodCaptures:
+		while (first < count)
+		{
+			const Move move = moves[first++];
+
+			if (move == hashMove)
+				continue;
+
+			// losing captures wait until after the killers
+			if (!move.isPromotion() && position.See(move) < 0)
+			{
+				badCaptures[badCount++] = move;
+				continue;
+			}
+			return move;
+		}
+		stage = Stage::Killers;
+		[[fallthrough]];
+
+	case Stage::Killers:
+		while (killer < 2)
+		{
+			const Move move = killer++ == 0 ? info.firstKiller(killerPly) : info.secondKiller(killerPly);
+
+			if (move != hashMove
+				&& !move.isNull()
+				&& !move.isPromotion()
+				&& !position.isCapture(move)
+				&& moveGen::isPseudoLegal(move, position))
+				return killers[killer - 1] = move;
+		}
+		stage = Stage::BadCaptures;
+		[[fallthrough]];
+
+	case Stage::BadCaptures:
+		// still ahead of the quiets, like the old single sorted list had them
+		// ahead of all but the best history moves
+		if (badIndex < badCount)
+			return badCaptures[badIndex++];
+		stage = Stage::GenQuiets;
+		[[fallthrough]];
+
+	case Stage::GenQuiets:
+		generateQuiets();
+		// only moves with some history are worth ordering
+		sortMoves(first, 1);
+		stage = Stage::Quiets;
+		[[fallthrough]];
+
+	case Stage::Quiets:
+		while (first < count)
+		{
+			const Move move = moves[first++];
+
+			if (move != hashMove && move != killers[0] && move != killers[1])
+				return move;
+		}
+		return nullMove;
+
+	default:
+		return nullMove;
 	}
 }
@@ -1,3 +1,4 @@
+#include "cpu.h"
 #include "defines.h"
 #include "direction.h"
 #include "piece.h"
@@ -7,9 +8,11 @@ uint64_t Moves::pawnAttacks[2][64];
 uint64_t Moves::kingAttacks[64];
 uint64_t Moves::knightAttacks[64];
 
-#ifdef PEXT
-uint64_t Moves::RookMask[64];
-#endif
+bool Moves::usePext = false;
+uint64_t Moves::rookMask[64];
+uint64_t Moves::bishopMask[64];
+uint64_t Moves::pextRookAttacks[64][4096];
+uint64_t Moves::pextBishopAttacks[64][512];
 
 uint64_t Moves::rankAttacks[64][64];
 uint64_t Moves::fileAttacks[64][64];
@@ -39,15 +42,8 @@ void Moves::initAttacks()
 	initPseudoAttacks();
 	initObstructedTable();
 
-#ifdef PEXT
-	initRookAttacks();
-	for (auto sq = 0; sq < 64; sq++)
-	{
-		auto f = Square::getFileIndex(sq);
-		auto r = Square::getRankIndex(sq);
-		RookMask[sq] = Masks::sixBitRankMask[r] | Masks::sixBitFileMask[f];
-	}
-#endif
+	initPextAttacks();
+
 	for (auto sq1 = 0; sq1 < 64; sq1++)
 		for (auto sq2 = 0; sq2 < 64; sq2++)
 			Distance[sq1][sq2] = Square::Distance(sq1, sq2);
@@ -290,69 +286,39 @@ void Moves::initObstructedTable()
 	}
 }
 
-#ifdef PEXT
-uint64_t Moves::RookAttacks[64][64 * 64];
-
-void Moves::initRookAttacks()
+// with a fast pext the occupancy of the squares that can block a slider is
+// its index into a table of the attacks, filled from the magic lookups
+bool Moves::initPextAttacks()
 {
-	for (auto sq = 0; sq < 64; sq++)
-	{
-		auto f = Square::getFileIndex(sq);
-		auto r = Square::getRankIndex(sq);
+	usePext = Cpu::features().FastPext;
 
-		for (auto occ = 0; occ < 64 * 64; occ++)
-		{
-			int f_occ = 0, r_occ = 0;
-			int word = occ;
-			int f_bits = 0;
-
-			if (r >= 1 && r <= 6 && f >= 1 && f <= 6)
-			{
-				f_occ = word & ((1 << (r - 1)) - 1);
-				word >>= r - 1;
-				f_bits += r - 1;
-				f_bits++;
-				r_occ = word & ((1 << 6) - 1);
-				word >>= 6;
-				f_occ |= word << f_bits;
-			}
+	if (!usePext)
+		return false;
 
-			else if (r == 0)
-			{
-				r_occ = word & ((1 << 6) - 1);
-				word >>= 6;
-				f_occ = word;
-			}
+	constexpr uint64_t edges = 0xff000000000000ff | 0x8181818181818181;
 
-			else if (r == 7)
-			{
-				f_occ = word & ((1 << 6) - 1);
-				word >>= 6;
-				r_occ = word;
-			}
-
-			else if (f == 0)
-			{
-				f_occ = word & ((1 << r) - 1);
-				word >>= r;
-				f_bits += r;
-				r_occ = word & ((1 << 6) - 1);
-				word >>= 6;
-				f_occ |= word << f_bits;
-			}
-
-			else if (f == 7)
-			{
-				f_occ = word & ((1 << (r - 1)) - 1);
-				word >>= r - 1;
-				f_bits += r - 1;
-				r_occ = word & ((1 << 6) - 1);
-				word >>= 6;
-				f_occ |= word << f_bits;
-			}
+	for (uint8_t sq = 0; sq < 64; sq++)
+	{
+		const int rank = Square::getRankIndex(sq);
+		const int file = Square::getFileIndex(sq);
+		rookMask[sq] = (Masks::sixBitRankMask[rank] | Masks::sixBitFileMask[file]) & ~Masks::squareMask[sq];
+		bishopMask[sq] = (Masks::A1H8diagMask[Square::getA1H8DiagonalIndex(sq)]
+			| Masks::H1A8diagMask[Square::getH1A8AntiDiagonalIndex(sq)]) & ~edges & ~Masks::squareMask[sq];
+
+		// every subset of the masks, enumerated with the carry-rippler trick
+		uint64_t occ = 0;
+		do
+		{
+			pextRookAttacks[sq][pext(occ, rookMask[sq])] = getRankAttacks(occ, sq) | getFileAttacks(occ, sq);
+			occ = (occ - rookMask[sq]) & rookMask[sq];
+		} while (occ);
 
-			RookAttacks[sq][occ] = rankAttacks[sq][r_occ] | fileAttacks[sq][f_occ];
-		}
+		do
+		{
+			pextBishopAttacks[sq][pext(occ, bishopMask[sq])] =
+				getA1H8DiagonalAttacks(occ, sq) | getH1A8DiagonalAttacks(occ, sq);
+			occ = (occ - bishopMask[sq]) & bishopMask[sq];
+		} while (occ);
 	}
+	return true;
 }
-#endif
@@ -17,18 +17,15 @@ public:
 	static uint64_t frontSpan[2][64]; // color, square
 	static uint64_t passerSpan[2][64]; // color, square
 	static int Distance[64][64]; // square, square
+	static bool usePext; // slider attacks from the pext tables instead of the magics
 	static uint64_t getA1H8DiagonalAttacks(uint64_t, uint8_t);
 	static uint64_t getH1A8DiagonalAttacks(uint64_t, uint8_t);
-	static bool AreSquaresAligned(uint8_t, uint8_t, uint8_t);
-	static void initAttacks();
-
-#ifdef PEXT
-	static uint64_t RookAttacks[64][64 * 64]; // square, occupancy (12 bits)
-	static uint64_t getRookAttacks(uint64_t, uint8_t);
-#else
 	static uint64_t getRankAttacks(uint64_t, uint8_t);
 	static uint64_t getFileAttacks(uint64_t, uint8_t);
-#endif
+	static uint64_t getRookAttacks(uint64_t, uint8_t);
+	static uint64_t getBishopAttacks(uint64_t, uint8_t);
+	static bool AreSquaresAligned(uint8_t, uint8_t, uint8_t);
+	static void initAttacks();
 
 private:
 	static uint64_t rankAttacks[64][64]; // square , occupancy
@@ -46,19 +43,13 @@ private:
 	static void initPseudoAttacks();
 	static void initObstructedTable();
 
-#ifdef PEXT
-	static uint64_t RookMask[64];
-	static void initRookAttacks();
-#endif
+	static uint64_t rookMask[64]; // square
+	static uint64_t bishopMask[64]; // square
+	static uint64_t pextRookAttacks[64][4096]; // square, occupancy (up to 12 bits)
+	static uint64_t pextBishopAttacks[64][512]; // square, occupancy (up to 9 bits)
+	static bool initPextAttacks();
 };
 
-#ifdef PEXT
-INLINE uint64_t Moves::getRookAttacks(uint64_t occupiedSquares, uint8_t square)
-{
-	auto pext = _pext_u64(occupiedSquares, Moves::RookMask[square]);
-	return Moves::RookAttacks[square][pext];
-}
-#else
 INLINE uint64_t Moves::getRankAttacks(const uint64_t occupiedSquares, const uint8_t square)
 {
 	const int rank = Square::getRankIndex(square);
@@ -73,31 +64,38 @@ INLINE uint64_t Moves::getFileAttacks(const uint64_t occupiedSquares, const uint
 		56);
 	return fileAttacks[square][(occupancy >> 1) & 63];
 }
-#endif
 
 INLINE uint64_t Moves::getA1H8DiagonalAttacks(uint64_t occupiedSquares, const uint8_t square)
 {
-	int diag = Square::getA1H8DiagonalIndex(square);
-
-#ifdef PEXT
-	auto occupancy = _pext_u64(occupiedSquares, Masks::sixBitA1H8diagMask[diag]);
-#else
-	int occupancy = static_cast<int>((occupiedSquares & Masks::A1H8diagMask[diag]) * Magics::A1H8diagMagic[diag] >> 56);
-#endif
+	const int diag = Square::getA1H8DiagonalIndex(square);
+	const int occupancy = static_cast<int>((occupiedSquares & Masks::A1H8diagMask[diag]) * Magics::A1H8diagMagic[diag] >> 56);
 	return A1H8diagonalAttacks[square][(occupancy >> 1) & 63];
 }
 
 INLINE uint64_t Moves::getH1A8DiagonalAttacks(uint64_t occupiedSquares, const uint8_t square)
 {
-	int diag = Square::getH1A8AntiDiagonalIndex(square);
-#ifdef PEXT
-	auto occupancy = _pext_u64(occupiedSquares, Masks::sixBitH1A8DdiagMask[diag]);
-#else
-	int occupancy = static_cast<int>((occupiedSquares & Masks::H1A8diagMask[diag]) * Magics::H1A8diagMagic[diag] >> 56);
-#endif
+	const int diag = Square::getH1A8AntiDiagonalIndex(square);
+	const int occupancy = static_cast<int>((occupiedSquares & Masks::H1A8diagMask[diag]) * Magics::H1A8diagMagic[diag] >> 56);
 	return H1A8diagonalAttacks[square][(occupancy >> 1) & 63];
 }
 
+// one lookup with a fast pext, the rank and file magics otherwise
+INLINE uint64_t Moves::getRookAttacks(const uint64_t occupiedSquares, const uint8_t square)
+{
+	if (usePext)
+		return pextRookAttacks[square][pext(occupiedSquares, rookMask[square])];
+
+	return getRankAttacks(occupiedSquares, square) | getFileAttacks(occupiedSquares, square);
+}
+
+INLINE uint64_t Moves::getBishopAttacks(const uint64_t occupiedSquares, const uint8_t square)
+{
+	if (usePext)
+		return pextBishopAttacks[square][pext(occupiedSquares, bishopMask[square])];
+
+	return getA1H8DiagonalAttacks(occupiedSquares, square) | getH1A8DiagonalAttacks(occupiedSquares, square);
+}
+
 INLINE bool Moves::AreSquaresAligned(const uint8_t s1, const uint8_t s2, const uint8_t s3)
 {
 	return (obstructedTable[s1][s2] | obstructedTable[s1][s3] | obstructedTable[s2][s3])
@@ -0,0 +1,97 @@
+#ifndef ARCH_H
+#define ARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include "nnue.h"
+
+/**
+* Shared between nnue.cpp, which loads the network and picks the kernels
+* at startup, and the kernels-*.cpp files, which compile kernels.h once per
+* instruction set
+*/
+enum
+{
+	PS_W_PAWN = 1,
+	PS_B_PAWN = 1 * 64 + 1,
+	PS_W_KNIGHT = 2 * 64 + 1,
+	PS_B_KNIGHT = 3 * 64 + 1,
+	PS_W_BISHOP = 4 * 64 + 1,
+	PS_B_BISHOP = 5 * 64 + 1,
+	PS_W_ROOK = 6 * 64 + 1,
+	PS_B_ROOK = 7 * 64 + 1,
+	PS_W_QUEEN = 8 * 64 + 1,
+	PS_B_QUEEN = 9 * 64 + 1,
+	PS_END = 10 * 64 + 1
+};
+
+enum
+{
+	kHalfDimensions = 256,
+	FtInDims = 64 * PS_END,
+	// 64 * 641
+	FtOutDims = kHalfDimensions * 2
+};
+
+enum
+{
+	TransformerStart = 3 * 4 + 177,
+	NetworkStart = TransformerStart + 4 + 2 * 256 + 2 * 256 * 64 * 641
+};
+
+/**
+* The feature transformer has the same layout for every instruction set.
+* It is read from the net file or used in place in a weight cache file
+*/
+extern const int16_t* ft_biases;
+extern const int16_t* ft_weights;
+
+/**
+* Accumulator halves by perspective and king square, with the pieces they
+* were computed for. Each thread keeps its own: a refresh after a king move
+* only applies the pieces that changed since that square was last seen
+*/
+using FinnyEntry = struct FinnyEntry
+{
+	alignas(64) int16_t accumulation[kHalfDimensions];
+	uint64_t pieces[14]; /** bitboards by piece code */
+	unsigned network; /** entries of another network than network_generation are stale */
+};
+
+extern thread_local FinnyEntry finny_table[2][64];
+extern unsigned network_generation;
+
+/**
+* The hidden layers are permuted for the simd width they are read with,
+* so each set of kernels keeps its own copy
+*/
+using NnueKernels = struct NnueKernels
+{
+	const char* name;
+	void (*init_network)(const char* d); /** d points past the network header */
+	int (*evaluate_pos)(const Position* pos);
+	void (*evaluate_batch)(const Position* pos, int count, int* scores);
+	size_t network_size; /** bytes of the hidden layers in the layout of the kernels */
+	const void* (*network)(); /** the hidden layers in use */
+	void (*map_network)(const void* d); /** use the hidden layers at d, 64 byte aligned */
+};
+
+/**
+* Positions that go through the dense layers together
+*/
+enum
+{
+	BatchSize = 16
+};
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define NNUE_X86
+extern const NnueKernels avx512vnni_kernels;
+extern const NnueKernels avx512_kernels;
+extern const NnueKernels avxvnni_kernels;
+extern const NnueKernels avx2_kernels;
+extern const NnueKernels sse41_kernels;
+#endif
+extern const NnueKernels generic_kernels;
+
+#endif
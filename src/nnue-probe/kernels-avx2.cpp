@@ -0,0 +1,18 @@
+/**
+* Kernels for cpus with avx2
+*/
+#include "arch.h"
+
+#ifdef NNUE_X86
+#define USE_AVX2 1
+#define USE_SSE41 1
+#define USE_SSSE3 1
+#define USE_SSE2 1
+#define USE_SSE 1
+#ifdef __GNUC__
+#define NNUE_TARGET _Pragma("GCC target(\"avx2,popcnt\")")
+#endif
+#define NNUE_NAME "avx2"
+#define NNUE_KERNELS avx2_kernels
+#include "kernels.h"
+#endif
@@ -0,0 +1,19 @@
+/**
+* Kernels for cpus with avx512f and avx512bw
+*/
+#include "arch.h"
+
+#ifdef NNUE_X86
+#define USE_AVX512 1
+#define USE_AVX2 1
+#define USE_SSE41 1
+#define USE_SSSE3 1
+#define USE_SSE2 1
+#define USE_SSE 1
+#ifdef __GNUC__
+#define NNUE_TARGET _Pragma("GCC target(\"avx512f,avx512bw,avx2,popcnt\")")
+#endif
+#define NNUE_NAME "avx512"
+#define NNUE_KERNELS avx512_kernels
+#include "kernels.h"
+#endif
@@ -0,0 +1,20 @@
+/**
+* Kernels for cpus with avx512f, avx512bw, avx512vl and avx512vnni
+*/
+#include "arch.h"
+
+#ifdef NNUE_X86
+#define USE_VNNI 1
+#define USE_AVX512 1
+#define USE_AVX2 1
+#define USE_SSE41 1
+#define USE_SSSE3 1
+#define USE_SSE2 1
+#define USE_SSE 1
+#ifdef __GNUC__
+#define NNUE_TARGET _Pragma("GCC target(\"avx512f,avx512bw,avx512vl,avx512vnni,avx2,popcnt\")")
+#endif
+#define NNUE_NAME "avx512vnni"
+#define NNUE_KERNELS avx512vnni_kernels
+#include "kernels.h"
+#endif
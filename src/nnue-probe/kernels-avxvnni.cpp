@@ -0,0 +1,19 @@
+/**
+* Kernels for cpus with avx2 and avx-vnni
+*/
+#include "arch.h"
+
+#ifdef NNUE_X86
+#define USE_VNNI 1
+#define USE_AVX2 1
+#define USE_SSE41 1
+#define USE_SSSE3 1
+#define USE_SSE2 1
+#define USE_SSE 1
+#ifdef __GNUC__
+#define NNUE_TARGET _Pragma("GCC target(\"avx2,avxvnni,popcnt\")")
+#endif
+#define NNUE_NAME "avxvnni"
+#define NNUE_KERNELS avxvnni_kernels
+#include "kernels.h"
+#endif
@@ -0,0 +1,7 @@
+/**
+* Kernels in plain c++ for any cpu, vectorised only by the compiler flags
+* of the build (or with USE_NEON and USE_MMX on other architectures)
+*/
+#define NNUE_NAME "generic"
+#define NNUE_KERNELS generic_kernels
+#include "kernels.h"
@@ -0,0 +1,17 @@
+/**
+* Kernels for cpus with sse4.1
+*/
+#include "arch.h"
+
+#ifdef NNUE_X86
+#define USE_SSE41 1
+#define USE_SSSE3 1
+#define USE_SSE2 1
+#define USE_SSE 1
+#ifdef __GNUC__
+#define NNUE_TARGET _Pragma("GCC target(\"sse4.1\")")
+#endif
+#define NNUE_NAME "sse41"
+#define NNUE_KERNELS sse41_kernels
+#include "kernels.h"
+#endif
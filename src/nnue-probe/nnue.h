@@ -91,9 +91,11 @@ using Position = struct Position
 	int* pieces;
 	int* squares;
 	NNUEdata* nnue[3];
+	int plies; /** NNUEdata of earlier plies stored right before nnue[0] */
 };
 
 int nnue_evaluate_pos(const Position* pos);
+void nnue_evaluate_pos_batch(const Position* pos, int count, int* scores);
 
 /************************************************************************
 *         EXTERNAL INTERFACES
@@ -109,16 +111,49 @@ int nnue_evaluate_pos(const Position* pos);
 *   b) nnue_evaluate             - suitable for use in engines
 *   c) nnue_evaluate_incremental - for ultimate performance but will need
 *                                  some work on the engines side.
+*   d) nnue_evaluate_lazy        - as c) with the NNUEdata of every ply
+*                                  kept in one array
+*   e) nnue_evaluate_batch       - many unrelated positions at once, for
+*                                  scoring files of positions
 *
 **************************************************************************/
 
 /**
-* Load NNUE file
+* Load NNUE file, or map the weight cache written for it by
+* @nnue_write_cache when there is one
 */
 void _CDECL nnue_init(
 	const char* evalFile /** Path to NNUE file */
 );
 
+/**
+* Name of the kernels nnue_init picked for the cpu: avx512vnni,
+* avx512, avxvnni, avx2, sse41 or generic
+*/
+const char* _CDECL nnue_kernels();
+
+/**
+* Write the loaded network to <evalFile>.cache, in the layout of the
+* kernels in use. nnue_init maps such a file and uses it in place, which
+* makes loading near instant, as long as the net file next to it is the
+* one it was written from
+* Returns
+*   1 when the file was written, 0 otherwise
+*/
+int _CDECL nnue_write_cache(
+	const char* evalFile /** Path to the NNUE file the network was loaded from */
+);
+
+/**
+* Check <evalFile>.cache against the whole of the net file. nnue_init
+* only compares the size and a sample of the net, to stay fast
+* Returns
+*   1 when the cache was written from this net file, 0 otherwise
+*/
+int _CDECL nnue_verify_cache(
+	const char* evalFile /** Path to the NNUE file */
+);
+
 /**
 * Evaluate on FEN string
 * Returns
@@ -128,6 +163,15 @@ int _CDECL nnue_evaluate_fen(
 	const char* fen /** FEN string to probe evaluation for */
 );
 
+/**
+* Evaluate count FEN strings, see @nnue_evaluate_batch
+*/
+void _CDECL nnue_evaluate_fen_batch(
+	int count, /** Number of positions */
+	const char** fens, /** FEN strings to probe evaluation for */
+	int* scores /** Receives the score of each position */
+);
+
 /**
 * Evaluation subroutine suitable for chess engines.
 * -------------------------------------------------
@@ -169,4 +213,44 @@ int _CDECL nnue_evaluate_incremental(
 	NNUEdata** nnue_data /** Pointer to NNUEdata* for current and previous plies */
 );
 
+/**
+* Batch NNUE evaluation function.
+* -------------------------------------------------
+* Parameters of position i and its score are as in @nnue_evaluate
+*
+* The positions go through each layer of the network together, so its
+* weights are read once for many positions. Every position is computed
+* from scratch, which suits positions that are not related by moves
+*/
+void _CDECL nnue_evaluate_batch(
+	int count, /** Number of positions */
+	const int* players, /** Side to move of each position */
+	int** pieces, /** Array of pieces of each position */
+	int** squares, /** Array of squares of each position */
+	int* scores /** Receives the score of each position */
+);
+
+/**
+* Lazy incremental NNUE evaluation function.
+* -------------------------------------------------
+* First three parameters and return type are as in @nnue_evaluate
+*
+* Making a move only needs to fill in the DirtyPiece of its NNUEdata and
+* clear computedAccumulation. The accumulator is brought up to date from
+* the nearest earlier ply that has one, applying the dirty pieces of all
+* the plies in between in one pass, so positions that are never evaluated
+* cost nothing
+*
+* nnue_stack
+*    nnue_stack[0] is the NNUEdata for the current position
+*    nnue_stack[-1] .. nnue_stack[-plies] are the NNUEdata of earlier plies
+*/
+int _CDECL nnue_evaluate_lazy(
+	int player, /** Side to move: white=0 black=1 */
+	int* pieces, /** Array of pieces */
+	int* squares, /** Corresponding array of squares each piece stands on */
+	NNUEdata* nnue_stack, /** NNUEdata of the current ply */
+	int plies /** Number of earlier plies before nnue_stack */
+);
+
 #endif
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// perft counts by position and depth. a slot stores the count next to the key
+// xored with it, so a slot half written by another thread reads as a miss
+class PerftTable
+{
+public:
+	explicit PerftTable(int size);
+	bool Probe(uint64_t, int, uint64_t&) const;
+	void Save(uint64_t, int, uint64_t);
+
+private:
+	struct Slot
+	{
+		std::atomic<uint64_t> Check;
+		std::atomic<uint64_t> Nodes;
+	};
+
+	std::unique_ptr<Slot[]> slots;
+	uint64_t mask;
+	static uint64_t Key(uint64_t, int);
+};
+
+// size in megabytes, rounded down to a power of two slots
+inline PerftTable::PerftTable(const int size)
+{
+	uint64_t count = 1;
+
+	while (count * 2 * sizeof(Slot) <= static_cast<uint64_t>(size) * 1024 * 1024)
+		count *= 2;
+
+	slots = std::make_unique<Slot[]>(count);
+	mask = count - 1;
+}
+
+// the same position is stored once per depth
+inline uint64_t PerftTable::Key(const uint64_t key, const int depth)
+{
+	return key ^ static_cast<uint64_t>(depth) * 0x9E3779B97F4A7C15ull;
+}
+
+inline bool PerftTable::Probe(const uint64_t key, const int depth, uint64_t& nodes) const
+{
+	const uint64_t k = Key(key, depth);
+	const Slot& slot = slots[k & mask];
+	nodes = slot.Nodes.load(std::memory_order_relaxed);
+	return (slot.Check.load(std::memory_order_relaxed) ^ nodes) == k;
+}
+
+inline void PerftTable::Save(const uint64_t key, const int depth, const uint64_t nodes)
+{
+	const uint64_t k = Key(key, depth);
+	Slot& slot = slots[k & mask];
+	slot.Check.store(k ^ nodes, std::memory_order_relaxed);
+	slot.Nodes.store(nodes, std::memory_order_relaxed);
+}
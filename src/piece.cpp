@@ -137,46 +137,30 @@ uint64_t Knight::getKnightAttacks(const uint64_t knights)
 uint64_t Bishop::getAllTargets(const uint64_t bishops, const Pos& position)
 {
 	const uint64_t occupiedSquares = position.occupiedSquares;
-	uint64_t targets = Empty;
 	const uint8_t square = BSF(bishops);
-	targets |= Moves::getA1H8DiagonalAttacks(occupiedSquares, square);
-	targets |= Moves::getH1A8DiagonalAttacks(occupiedSquares, square);
+	const uint64_t targets = Moves::getBishopAttacks(occupiedSquares, square);
 	return targets & ~position.ourPieces();
 }
 
 uint64_t Bishop::targetsFrom(const uint8_t square, const uint8_t color, const Pos& position)
 {
 	const uint64_t occupiedSquares = position.occupiedSquares;
-	uint64_t targets = Empty;
-	targets |= Moves::getA1H8DiagonalAttacks(occupiedSquares, square);
-	targets |= Moves::getH1A8DiagonalAttacks(occupiedSquares, square);
+	const uint64_t targets = Moves::getBishopAttacks(occupiedSquares, square);
 	return targets & ~position.Pieces(color);
 }
 
 uint64_t Rook::getAllTargets(const uint64_t rooks, const Pos& position)
 {
-	uint64_t occupiedSquares = position.occupiedSquares;
-	uint64_t targets = Empty;
-	uint8_t square = BSF(rooks);
-#ifdef PEXT
-	targets = Moves::getRookAttacks(occupiedSquares, square);
-#else
-	targets |= Moves::getRankAttacks(occupiedSquares, square);
-	targets |= Moves::getFileAttacks(occupiedSquares, square);
-#endif
+	const uint64_t occupiedSquares = position.occupiedSquares;
+	const uint8_t square = BSF(rooks);
+	const uint64_t targets = Moves::getRookAttacks(occupiedSquares, square);
 	return targets & ~position.ourPieces();
 }
 
 uint64_t Rook::targetsFrom(uint8_t square, const uint8_t color, const Pos& position)
 {
-	uint64_t occupiedSquares = position.occupiedSquares;
-	uint64_t targets = Empty;
-#ifdef PEXT
-	targets = Moves::getRookAttacks(occupiedSquares, square);
-#else
-	targets |= Moves::getRankAttacks(occupiedSquares, square);
-	targets |= Moves::getFileAttacks(occupiedSquares, square);
-#endif
+	const uint64_t occupiedSquares = position.occupiedSquares;
+	const uint64_t targets = Moves::getRookAttacks(occupiedSquares, square);
 	return targets & ~position.Pieces(color);
 }
 
@@ -17,6 +17,7 @@ namespace Piece
 	char getColor(uint8_t);
 	char getInitial(pieceInfo);
 	uint8_t getOpposite(uint8_t);
+	int nnueCode(uint8_t, uint8_t);
 }
 
 INLINE uint8_t Piece::getOpposite(const uint8_t color)
@@ -44,6 +45,12 @@ enum pieceColor :
 	noColor
 };
 
+// nnue-probe piece codes: wking=1 ... wpawn=6, bking=7 ... bpawn=12
+INLINE int Piece::nnueCode(const uint8_t color, const uint8_t type)
+{
+	return (King + 1 - type) + 6 * color;
+}
+
 class Pos;
 
 class Knight
@@ -3,11 +3,10 @@
 #include "eval.h"
 #include "castle.h"
 
+// the attack and zobrist tables are filled once by main, before any
+// position is built, so positions can be created on any thread
 Pos::Pos() noexcept
 {
-	Moves::initAttacks();
-	Zobrist::Init();
-
 	pieces[White] = Empty;
 	pieces[Black] = Empty;
 	occupiedSquares = Empty;
@@ -35,6 +34,9 @@ void Pos::loadFen(const std::string& pos)
 	allowNullMove = true;
 	currentPly = 0;
 	zobrist = 0;
+	nnueHistory[0].accumulator.computedAccumulation = 0;
+	nnueCount = 2;
+	nnuePieceList[nnueCount] = blank;
 	initializeCastlingStatus(fenString);
 	initializesideToMove(fenString);
 	initializePieceSet(fenString);
@@ -45,6 +47,77 @@ void Pos::loadFen(const std::string& pos)
 	pstScore[Black] = calculatePST(Black);
 }
 
+void Pos::saveState(RootState& state) const
+{
+	for (uint8_t c = White; c < noColor; c++)
+		for (uint8_t t = Pawn; t < noType; t++)
+			state.Pieces[c][t] = bitBoardSet[c][t];
+
+	state.Key = zobrist;
+	state.SideToMove = sideToMove;
+	state.CastlingStatus = castlingStatus;
+	state.EnPassantSquare = enPassantSquare;
+	state.Castled[White] = castled[White];
+	state.Castled[Black] = castled[Black];
+	state.HalfMoveClock = halfMoveClock;
+	state.Ply = currentPly;
+	std::copy(hashHistory, hashHistory + currentPly, state.Keys);
+}
+
+// rebuilds the position the way loadFen does; the history below the root
+// ply is never undone by a search, so only the keys are restored
+void Pos::loadState(const RootState& state)
+{
+	for (uint8_t c = White; c < noColor; c++)
+		for (uint8_t t = Pawn; t < noType; t++)
+			numPieces[c][t] = 0;
+
+	for (uint8_t c = White; c < noColor; c++)
+		for (uint8_t f = 0; f < 8; f++)
+			pawnsOnFile[c][f] = 0;
+
+	material[White] = 0;
+	material[Black] = 0;
+	allowNullMove = true;
+	nnueCount = 2;
+	nnuePieceList[nnueCount] = blank;
+	clearPieceSet();
+
+	for (uint8_t c = White; c < noColor; c++)
+	{
+		for (uint8_t t = Pawn; t < noType; t++)
+		{
+			bitBoardSet[c][t] = state.Pieces[c][t];
+
+			for (uint64_t b = state.Pieces[c][t]; b;)
+				pieceSet[BSFReset(b)] = pieceInfo(c, t);
+		}
+		kingSquare[c] = static_cast<uint8_t>(BSF(bitBoardSet[c][King]));
+	}
+
+	for (uint8_t sq = Square::A1; sq <= Square::H8; sq++)
+		addPiece(pieceSet[sq], sq);
+
+	updateGenericBitBoards();
+
+	zobrist = state.Key;
+	sideToMove = state.SideToMove;
+	castlingStatus = state.CastlingStatus;
+	enPassantSquare = state.EnPassantSquare;
+	castled[White] = state.Castled[White];
+	castled[Black] = state.Castled[Black];
+	halfMoveClock = state.HalfMoveClock;
+	currentPly = state.Ply;
+	std::copy(state.Keys, state.Keys + currentPly, hashHistory);
+
+	// the evaluation walks back through every ply below this one
+	for (int i = 0; i <= currentPly; i++)
+		nnueHistory[i].accumulator.computedAccumulation = 0;
+
+	pstScore[White] = calculatePST(White);
+	pstScore[Black] = calculatePST(Black);
+}
+
 Score Pos::calculatePST(const uint8_t color) const
 {
 	int pst[2][2] =
@@ -75,6 +148,7 @@ void Pos::addPiece(const pieceInfo piece, const uint8_t sq)
 	{
 		numPieces[piece.Color][piece.Type]++;
 		material[piece.Color] += pieceValue[piece.Type];
+		nnueAdd(sq, piece.Color, piece.Type);
 		zobrist ^= Zobrist::pieceInfo[piece.Color][piece.Type][sq];
 
 		if (piece.Type == Pawn)
@@ -220,11 +294,23 @@ void Pos::makeMove(const Move move)
 	hashHistory[currentPly] = zobrist;
 	capturedPieceHistory[currentPly] = captured;
 
+	NNUEdata& nnue = nnueHistory[currentPly + 1];
+	DirtyPiece& dp = nnue.dirtyPiece;
+	nnue.accumulator.computedAccumulation = 0;
+	dp.dirtyNum = 1;
+	dp.pc[0] = Piece::nnueCode(sideToMove, pieceMoved);
+	dp.from[0] = from;
+	dp.to[0] = to;
+
 	zobrist ^= Zobrist::Color;
 
 	pieceSet[to] = pieceSet[from];
 	pieceSet[from] = Null;
 
+	if (capture && !move.isEnPassant())
+		nnueRemove(to);
+	nnueMove(from, to);
+
 	updatePstScore<Sub>(sideToMove, Eval::pieceSquareScore(pieceInfo(sideToMove, pieceMoved), from));
 	updatePstScore<Add>(sideToMove, Eval::pieceSquareScore(pieceInfo(sideToMove, pieceMoved), to));
 
@@ -280,6 +366,7 @@ void Pos::makeMove(const Move move)
 	{
 		const uint8_t promoted = move.piecePromoted();
 		pieceSet[to] = pieceInfo(sideToMove, promoted);
+		nnuePromote(to, sideToMove, promoted);
 		bitBoardSet[sideToMove][Pawn] ^= To;
 		bitBoardSet[sideToMove][promoted] ^= To;
 		numPieces[sideToMove][Pawn]--;
@@ -292,6 +379,12 @@ void Pos::makeMove(const Move move)
 		updatePstScore<Sub>(sideToMove, Eval::pieceSquareScore(pieceInfo(sideToMove, Pawn), to));
 		updatePstScore<Add>(sideToMove, Eval::pieceSquareScore(pieceInfo(sideToMove, promoted), to));
 
+		dp.to[0] = Square::noSquare;
+		dp.pc[dp.dirtyNum] = Piece::nnueCode(sideToMove, promoted);
+		dp.from[dp.dirtyNum] = Square::noSquare;
+		dp.to[dp.dirtyNum] = to;
+		dp.dirtyNum++;
+
 		if (!capture)
 			pawnsOnFile[sideToMove][Square::getFileIndex(from)]--;
 		else
@@ -300,6 +393,10 @@ void Pos::makeMove(const Move move)
 
 	if (capture)
 	{
+		dp.pc[dp.dirtyNum] = Piece::nnueCode(enemy, captured);
+		dp.from[dp.dirtyNum] = to;
+		dp.to[dp.dirtyNum] = Square::noSquare;
+
 		if (move.isEnPassant())
 		{
 			uint64_t piece;
@@ -308,6 +405,7 @@ void Pos::makeMove(const Move move)
 			{
 				piece = Masks::squareMask[enPassantSquare - 8];
 				pieceSet[enPassantSquare - 8] = Null;
+				nnueRemove(enPassantSquare - 8);
 				updatePstScore
 					<Sub>(enemy, Eval::pieceSquareScore(pieceInfo(enemy, Pawn), enPassantSquare - 8));
 				zobrist ^= Zobrist::pieceInfo[enemy][Pawn][enPassantSquare
@@ -317,6 +415,7 @@ void Pos::makeMove(const Move move)
 			{
 				piece = Masks::squareMask[enPassantSquare + 8];
 				pieceSet[enPassantSquare + 8] = Null;
+				nnueRemove(enPassantSquare + 8);
 				updatePstScore
 					<Sub>(enemy, Eval::pieceSquareScore(pieceInfo(enemy, Pawn), enPassantSquare + 8));
 				zobrist ^= Zobrist::pieceInfo[enemy][Pawn][enPassantSquare
@@ -327,6 +426,7 @@ void Pos::makeMove(const Move move)
 			bitBoardSet[enemy][Pawn] ^= piece;
 			occupiedSquares ^= FromTo ^ piece;
 			emptySquares ^= FromTo ^ piece;
+			dp.from[dp.dirtyNum] = BSF(piece);
 
 			pawnsOnFile[sideToMove][Square::getFileIndex(from)]--;
 			pawnsOnFile[sideToMove][Square::getFileIndex(to)]++;
@@ -374,6 +474,7 @@ void Pos::makeMove(const Move move)
 
 		numPieces[enemy][captured]--;
 		material[enemy] -= pieceValue[captured];
+		dp.dirtyNum++;
 		incrementClock = false;
 	}
 	else
@@ -400,7 +501,7 @@ void Pos::makeMove(const Move move)
 	}
 
 	if (castlingStatusHistory[currentPly] != castlingStatus)
-		zobrist ^= Zobrist::Castling[castlingStatus];
+		zobrist ^= Zobrist::Castling[castlingStatusHistory[currentPly]] ^ Zobrist::Castling[castlingStatus];
 
 	if (incrementClock)
 		halfMoveClock++;
@@ -427,7 +528,7 @@ void Pos::undoMove(const Move move)
 	zobrist ^= Zobrist::Color;
 
 	if (castlingStatusHistory[currentPly] != castlingStatus)
-		zobrist ^= Zobrist::Castling[castlingStatus];
+		zobrist ^= Zobrist::Castling[castlingStatusHistory[currentPly]] ^ Zobrist::Castling[castlingStatus];
 
 	if (enPassantSquare != Square::noSquare)
 		zobrist ^= Zobrist::Enpassant[Square::getFileIndex(enPassantSquare)];
@@ -445,6 +546,7 @@ void Pos::undoMove(const Move move)
 	sideToMove = Piece::getOpposite(sideToMove);
 
 	pieceSet[from] = pieceSet[to];
+	nnueMove(to, from);
 
 	if (!promotion)
 	{
@@ -486,6 +588,7 @@ void Pos::undoMove(const Move move)
 		material[sideToMove] += pieceValue[Pawn];
 		material[sideToMove] -= pieceValue[promoted];
 		pieceSet[from] = pieceInfo(sideToMove, Pawn);
+		nnuePromote(from, sideToMove, Pawn);
 		bitBoardSet[sideToMove][promoted] ^= To;
 		bitBoardSet[sideToMove][Pawn] ^= To;
 		zobrist ^= Zobrist::pieceInfo[sideToMove][Pawn][to];
@@ -513,6 +616,7 @@ void Pos::undoMove(const Move move)
 			{
 				piece = Masks::squareMask[enPassantSquare - offset];
 				pieceSet[enPassantSquare - offset] = pieceInfo(Black, Pawn);
+				nnueAdd(enPassantSquare - offset, Black, Pawn);
 				updatePstScore<Add>(enemy, Eval::pieceSquareScore(pieceInfo(enemy, Pawn), enPassantSquare - offset));
 				zobrist ^= Zobrist::pieceInfo[enemy][Pawn][enPassantSquare - offset];
 			}
@@ -520,6 +624,7 @@ void Pos::undoMove(const Move move)
 			{
 				piece = Masks::squareMask[enPassantSquare + offset];
 				pieceSet[enPassantSquare + offset] = pieceInfo(White, Pawn);
+				nnueAdd(enPassantSquare + offset, White, Pawn);
 				updatePstScore<Add>(enemy, Eval::pieceSquareScore(pieceInfo(enemy, Pawn), enPassantSquare + offset));
 				zobrist ^= Zobrist::pieceInfo[enemy][Pawn][enPassantSquare + offset];
 			}
@@ -553,6 +658,7 @@ void Pos::undoMove(const Move move)
 			updatePstScore<Add>(enemy, Eval::pieceSquareScore(pieceInfo(enemy, captured), to));
 
 			pieceSet[to] = pieceInfo(enemy, captured);
+			nnueAdd(to, enemy, captured);
 			bitBoardSet[enemy][captured] ^= To;
 
 			pieces[enemy] ^= To;
@@ -612,6 +718,13 @@ void Pos::makeCastle(const uint8_t from, const uint8_t to)
 	emptySquares ^= rook;
 	pieceSet[fromR] = Null;
 	pieceSet[toR] = pieceInfo(sideToMove, Rook);
+	nnueMove(fromR, toR);
+
+	DirtyPiece& dp = nnueHistory[currentPly + 1].dirtyPiece;
+	dp.pc[1] = Piece::nnueCode(sideToMove, Rook);
+	dp.from[1] = fromR;
+	dp.to[1] = toR;
+	dp.dirtyNum = 2;
 
 	updatePstScore<Sub>(sideToMove, Eval::pieceSquareScore(pieceInfo(sideToMove, Rook), fromR));
 	updatePstScore<Add>(sideToMove, Eval::pieceSquareScore(pieceInfo(sideToMove, Rook), toR));
@@ -660,6 +773,7 @@ void Pos::undoCastle(const uint8_t from, const uint8_t to)
 	emptySquares ^= rook;
 	pieceSet[fromR] = pieceInfo(sideToMove, Rook);
 	pieceSet[toR] = Null;
+	nnueMove(toR, fromR);
 
 	updatePstScore<Add>(sideToMove, Eval::pieceSquareScore(pieceInfo(sideToMove, Rook), fromR));
 	updatePstScore<Sub>(sideToMove, Eval::pieceSquareScore(pieceInfo(sideToMove, Rook), toR));
@@ -693,26 +807,15 @@ bool Pos::isAttacked(uint64_t target, const uint8_t side) const
 
 		if (slidingAttackers != 0)
 		{
-#ifdef PEXT
 			if ((Moves::getRookAttacks(occupiedSquares, to) & slidingAttackers) != 0)
 				return true;
-#else
-			if ((Moves::getRankAttacks(occupiedSquares, to) & slidingAttackers) != 0)
-				return true;
-
-			if ((Moves::getFileAttacks(occupiedSquares, to) & slidingAttackers) != 0)
-				return true;
-#endif
 		}
 
 		slidingAttackers = Pieces(enemyColor, Queen) | Pieces(enemyColor, Bishop);
 
 		if (slidingAttackers != 0)
 		{
-			if ((Moves::getH1A8DiagonalAttacks(occupiedSquares, to) & slidingAttackers) != 0)
-				return true;
-
-			if ((Moves::getA1H8DiagonalAttacks(occupiedSquares, to) & slidingAttackers) != 0)
+			if ((Moves::getBishopAttacks(occupiedSquares, to) & slidingAttackers) != 0)
 				return true;
 		}
 	}
@@ -13,6 +13,7 @@
 #include "evalterms.h"
 #include "searchinfo.h"
 #include "square.h"
+#include "nnue-probe/nnue.h"
 
 constexpr int maxPhase = 256;
 const pieceInfo Null = pieceInfo(noColor, noType);
@@ -22,6 +23,21 @@ constexpr uint64_t Empty = 0x0000000000000000;
 class MoveList;
 class Fen;
 
+// root of a search as handed to the helper threads: the board, the state
+// around it and the keys of the game so far, for repetition detection
+struct RootState
+{
+	uint64_t Pieces[2][6]{};
+	uint64_t Key{};
+	uint64_t Keys[maxPly]{};
+	uint8_t SideToMove{};
+	uint8_t CastlingStatus{};
+	uint8_t EnPassantSquare{};
+	bool Castled[2]{};
+	int HalfMoveClock{};
+	int Ply{};
+};
+
 enum GameStage
 {
 	OP = 0,
@@ -45,6 +61,8 @@ public:
 	Pos() noexcept;
 	void Display() const;
 	void loadFen(const std::string & = startPosition);
+	void saveState(RootState&) const;
+	void loadState(const RootState&);
 	void addPiece(pieceInfo, uint8_t);
 	uint64_t ourPieces() const;
 	uint64_t enemyPieces() const;
@@ -66,10 +84,9 @@ public:
 	void makeNullMove();
 	void undoNullMove();
 
-	void setCheckState(bool);
-
 	bool isCapture(Move) const;
-	bool isMoveLegal(Move, uint64_t);
+	bool isMoveLegal(Move, uint64_t) const;
+	bool isEnPassantLegal(Move) const;
 	bool isAttacked(uint64_t, uint8_t) const;
 	bool isPromotingPawn() const;
 	bool isOnSquare(uint8_t, uint8_t, uint8_t) const;
@@ -85,7 +102,6 @@ public:
 	int getCurrentPly() const;
 	bool getAllowNullMove() const;
 	void toggleNullMove();
-	bool getIsCheck() const;
 
 	Score getPstScore(uint8_t) const;
 	int getNumPieces(uint8_t, uint8_t) const;
@@ -101,6 +117,9 @@ public:
 
 	std::string getFen() const;
 	Move parseMove(const std::string&) const;
+	NNUEdata* getNnueData(int&) const;
+	const int* nnuePieces() const;
+	const int* nnueSquares() const;
 
 private:
 	uint8_t castlingStatusHistory[maxPly]{};
@@ -108,6 +127,7 @@ private:
 	uint8_t enpSquaresHistory[maxPly]{};
 	uint64_t hashHistory[maxPly]{};
 	int halfMoveClockHistory[maxPly]{};
+	mutable NNUEdata nnueHistory[maxPly]{};
 
 	uint64_t bitBoardSet[2][7]{};
 	uint8_t kingSquare[2]{};
@@ -115,6 +135,12 @@ private:
 	pieceInfo pieceSet[74];
 	uint64_t pieces[2]{};
 
+	// nnue-probe piece list: kings at 0 and 1, terminated by 0
+	int nnuePieceList[33]{};
+	int nnueSquareList[33]{};
+	uint8_t nnueIndex[64]{};
+	int nnueCount{};
+
 	uint8_t sideToMove{};
 	uint8_t castlingStatus{};
 	uint8_t enPassantSquare{};
@@ -122,7 +148,6 @@ private:
 	int halfMoveClock{};
 	int currentPly{};
 	bool allowNullMove{};
-	bool isCheck{};
 	bool castled[2] =
 	{
 		false, false
@@ -137,6 +162,11 @@ private:
 	template <Operation>
 	void updatePstScore(uint8_t, Score);
 
+	void nnueAdd(uint8_t, uint8_t, uint8_t);
+	void nnueRemove(uint8_t);
+	void nnueMove(uint8_t, uint8_t);
+	void nnuePromote(uint8_t, uint8_t, uint8_t);
+
 	void clearPieceSet();
 	void updateGenericBitBoards();
 	void initializeBitBoards(const Fen&);
@@ -175,7 +205,7 @@ INLINE uint64_t Pos::pinnedPieces() const
 	return pinned;
 }
 
-INLINE bool Pos::isMoveLegal(const Move move, const uint64_t pinned)
+INLINE bool Pos::isMoveLegal(const Move move, const uint64_t pinned) const
 {
 	if (pieceSet[move.fromSquare()].Type == King)
 	{
@@ -183,30 +213,28 @@ INLINE bool Pos::isMoveLegal(const Move move, const uint64_t pinned)
 	}
 
 	if (move.isEnPassant())
-	{
-		makeMove(move);
-		const bool islegal =
-			!isAttacked(bitBoardSet[Piece::getOpposite(sideToMove)][King], Piece::getOpposite(sideToMove));
-		undoMove(move);
-		return islegal;
-	}
+		return isEnPassantLegal(move);
 
 	return (pinned == 0) || ((pinned & Masks::squareMask[move.fromSquare()]) == 0)
 		|| Moves::AreSquaresAligned(move.fromSquare(), move.toSquare(), kingSquare[sideToMove]);
 }
 
+// en passant empties two squares on one rank, which the pin test cannot see,
+// so the king is looked at again with both pawns gone
+INLINE bool Pos::isEnPassantLegal(const Move move) const
+{
+	const uint8_t to = move.toSquare();
+	const uint64_t captured = Masks::squareMask[sideToMove == White ? to - 8 : to + 8];
+	const uint64_t occ = (occupiedSquares ^ Masks::squareMask[move.fromSquare()] ^ captured) | Masks::squareMask[to];
+
+	return (attacksTo(kingSquare[sideToMove], Piece::getOpposite(sideToMove), occ) & ~captured) == 0;
+}
+
 INLINE uint64_t Pos::kingAttackers(uint8_t square, const uint8_t color) const
 {
 	const uint8_t opp = Piece::getOpposite(color);
-	const uint64_t bishopAttacks =
-		Moves::getA1H8DiagonalAttacks(occupiedSquares, square) | Moves::getH1A8DiagonalAttacks(occupiedSquares, square);
-
-#ifdef PEXT
-	uint64_t rookAttacks = Moves::getRookAttacks(occupiedSquares, square);
-#else
-	uint64_t rookAttacks =
-		Moves::getFileAttacks(occupiedSquares, square) | Moves::getRankAttacks(occupiedSquares, square);
-#endif
+	const uint64_t bishopAttacks = Moves::getBishopAttacks(occupiedSquares, square);
+	const uint64_t rookAttacks = Moves::getRookAttacks(occupiedSquares, square);
 
 	return (Moves::pawnAttacks[color][square] & bitBoardSet[opp][Pawn])
 		| (Moves::knightAttacks[square] & bitBoardSet[opp][Knight])
@@ -217,14 +245,8 @@ INLINE uint64_t Pos::kingAttackers(uint8_t square, const uint8_t color) const
 INLINE uint64_t Pos::attacksTo(uint8_t square, const uint8_t color, uint64_t occ) const
 {
 	const uint8_t opp = Piece::getOpposite(color);
-	const uint64_t bishopAttacks = Moves::getA1H8DiagonalAttacks(occ, square) |
-		Moves::getH1A8DiagonalAttacks(occ, square);
-
-#ifdef PEXT
-	uint64_t rookAttacks = Moves::getRookAttacks(occ, square);
-#else
-	uint64_t rookAttacks = Moves::getFileAttacks(occ, square) | Moves::getRankAttacks(occ, square);
-#endif
+	const uint64_t bishopAttacks = Moves::getBishopAttacks(occ, square);
+	const uint64_t rookAttacks = Moves::getRookAttacks(occ, square);
 
 	return (Moves::kingAttacks[square] & bitBoardSet[color][King])
 		| (Moves::pawnAttacks[opp][square] & bitBoardSet[color][Pawn])
@@ -235,14 +257,8 @@ INLINE uint64_t Pos::attacksTo(uint8_t square, const uint8_t color, uint64_t occ
 
 INLINE uint64_t Pos::movesTo(uint8_t square, const uint8_t color, uint64_t occ) const
 {
-	const uint64_t bishopAttacks = Moves::getA1H8DiagonalAttacks(occ, square) |
-		Moves::getH1A8DiagonalAttacks(occ, square);
-
-#ifdef PEXT
-	uint64_t rookAttacks = Moves::getRookAttacks(occ, square);
-#else
-	uint64_t rookAttacks = Moves::getFileAttacks(occ, square) | Moves::getRankAttacks(occ, square);
-#endif
+	const uint64_t bishopAttacks = Moves::getBishopAttacks(occ, square);
+	const uint64_t rookAttacks = Moves::getRookAttacks(occ, square);
 
 	uint8_t pawnSquare;
 	uint64_t pawn = 0;
@@ -293,6 +309,11 @@ INLINE uint64_t Pos::movesTo(uint8_t square, const uint8_t color, uint64_t occ)
 
 inline void Pos::makeNullMove()
 {
+	NNUEdata& nnue = nnueHistory[currentPly + 1];
+	nnue.accumulator.computedAccumulation = 0;
+	nnue.dirtyPiece.dirtyNum = 0;
+	nnue.dirtyPiece.pc[0] = blank;
+
 	hashHistory[currentPly] = zobrist;
 	enpSquaresHistory[currentPly] = enPassantSquare;
 	sideToMove = Piece::getOpposite(sideToMove);
@@ -359,16 +380,6 @@ inline void Pos::toggleNullMove()
 	allowNullMove = !allowNullMove;
 }
 
-inline bool Pos::getIsCheck() const
-{
-	return isCheck;
-}
-
-inline void Pos::setCheckState(const bool isCheck)
-{
-	this->isCheck = isCheck;
-}
-
 inline uint64_t Pos::ourPieces() const
 {
 	return pieces[sideToMove];
@@ -399,6 +410,55 @@ inline const pieceInfo* Pos::pieceList() const
 	return pieceSet;
 }
 
+// accumulator of the current ply; the plies before it lie right below in
+// nnueHistory, back to the position that was loaded
+inline NNUEdata* Pos::getNnueData(int& plies) const
+{
+	plies = currentPly;
+	return &nnueHistory[currentPly];
+}
+
+inline const int* Pos::nnuePieces() const
+{
+	return nnuePieceList;
+}
+
+inline const int* Pos::nnueSquares() const
+{
+	return nnueSquareList;
+}
+
+inline void Pos::nnueAdd(const uint8_t sq, const uint8_t color, const uint8_t type)
+{
+	const int index = type == King ? color : nnueCount++;
+	nnuePieceList[index] = Piece::nnueCode(color, type);
+	nnueSquareList[index] = sq;
+	nnueIndex[sq] = static_cast<uint8_t>(index);
+	nnuePieceList[nnueCount] = blank;
+}
+
+inline void Pos::nnueRemove(const uint8_t sq)
+{
+	const int index = nnueIndex[sq];
+	const int last = --nnueCount;
+	nnuePieceList[index] = nnuePieceList[last];
+	nnueSquareList[index] = nnueSquareList[last];
+	nnueIndex[nnueSquareList[index]] = static_cast<uint8_t>(index);
+	nnuePieceList[last] = blank;
+}
+
+inline void Pos::nnueMove(const uint8_t from, const uint8_t to)
+{
+	const int index = nnueIndex[from];
+	nnueSquareList[index] = to;
+	nnueIndex[to] = static_cast<uint8_t>(index);
+}
+
+inline void Pos::nnuePromote(const uint8_t sq, const uint8_t color, const uint8_t type)
+{
+	nnuePieceList[nnueIndex[sq]] = Piece::nnueCode(color, type);
+}
+
 inline bool Pos::isPromotingPawn() const
 {
 	const uint64_t rank = (sideToMove == White ? Ranks::Seven : Ranks::Two);
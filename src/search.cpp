@@ -1,17 +1,19 @@
-#include <random>
+#include <memory>
 #include "search.h"
 #include "eval.h"
 #include "movepick.h"
 #include "searchterms.h"
 
 hashTable Search::Hash;
-bool Search::pondering = false;
+std::atomic<bool> Search::pondering(false);
 std::atomic<bool> Search::ponderHit(false);
 std::atomic<bool> Search::stopSignal(true);
 std::atomic<bool> Search::quit(false);
 int Search::gameTime[2];
 int Search::moveTime;
 thread_local bool Search::sendOutput = false;
+thread_local bool Search::analysing = false;
+thread_local bool Search::aborted = false;
 thread_local SearchInfo Search::searchInfo;
 std::vector<std::thread> Search::threads;
 SMPInfo Search::smpInfo;
@@ -20,6 +22,12 @@ std::mutex mux;
 int Search::depth_limit = 100;
 int Search::cores;
 const int Search::defaultCores = 1;
+std::atomic<const SearchInfo*> Search::threadInfo[maxThreads];
+
+// helper threads skip depths in a per-thread pattern, so that at any time
+// they are spread over several depths instead of all racing on the same one
+constexpr int skipSize[] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+constexpr int skipPhase[] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
 
 int Search::razorMargin(const int depth)
 {
@@ -39,13 +47,16 @@ int Search::predictTime(const uint8_t color)
 
 Move Search::startThinking(const SearchType type, Pos& position, const bool verbose)
 {
-	Hash.Clear();
+	Hash.newSearch();
 
 	sendOutput = verbose;
 	stopSignal = false;
+	Eval::cache.setSize(Eval::cacheSize);
+	Eval::cache.resetStats();
 	pondering = false;
 	ponderHit = false;
 	searchInfo.setDepthLimit(depth_limit);
+	threadInfo[0] = &searchInfo;
 
 	if (type == SearchType::Infinite || type == SearchType::Ponder)
 	{
@@ -70,10 +81,35 @@ Move Search::startThinking(const SearchType type, Pos& position, const bool verb
 		searchInfo.newSearch(time);
 	}
 
-	const Move move = iterativeSearch(position);
+	if (cores > 1)
+		startHelpers(position);
+
+	Move move = iterativeSearch(position).BestMove;
+	stopThinking();
+
+	if (cores > 1)
+	{
+		waitHelpers();
+		const Move voted = smpInfo.bestMove();
+
+		if (!voted.isNull())
+			move = voted;
+	}
 
 	if (sendOutput)
 	{
+		std::cout << "info string nodes";
+		for (auto i = 0; i < cores; i++)
+		{
+			const SearchInfo* info = threadInfo[i];
+			std::cout << " " << (info ? info->Nodes() : 0);
+		}
+		std::cout << std::endl;
+
+		const uint64_t probes = Eval::cache.Probes();
+		std::cout << "info string evalcache hits " << Eval::cache.Hits() << " probes " << probes
+			<< " hitrate " << (probes ? Eval::cache.Hits() * 1000 / probes : 0) << " permill" << std::endl;
+
 		const Move ponder = getPonderMove(position, move);
 
 		if (ponder.isNull())
@@ -88,79 +124,149 @@ Move Search::startThinking(const SearchType type, Pos& position, const bool verb
 void Search::stopThinking()
 {
 	stopSignal = true;
-	smpInfo.setReady(false);
 }
 
 void Search::killThreads()
 {
+	stopSignal = true;
 	quit = true;
 	smp.notify_all();
 
 	for (auto& t : threads)
 		t.join();
 	threads.clear();
+	std::fill(threadInfo + 1, threadInfo + maxThreads, nullptr);
 	quit = false;
 }
 
 void Search::initThreads(const int num_threads)
 {
 	killThreads();
+	cores = std::min(num_threads, maxThreads);
+	for (int i = 1; i < cores; i++)
+		threads.emplace_back(smpSearch, i, smpInfo.searchId());
+}
+
+void Search::startHelpers(const Pos& position)
+{
 	{
 		std::lock_guard<std::mutex> lock(mux);
-		smpInfo.setReady(false);
+		smpInfo.startSearch(position, cores);
 	}
-	cores = num_threads;
-	for (int i = 1; i < cores; i++)
-		threads.emplace_back(smpSearch);
+	smp.notify_all();
 }
 
-void Search::signalThreads(const int depth, const int alpha, const int beta, const Pos& position, const bool ready)
+// sum of the per-thread counters; helpers keep counting while this runs,
+// so the total is a snapshot, never a double count
+uint64_t Search::totalNodes()
 {
-	std::unique_lock<std::mutex> lock(mux);
-	smpInfo.updateInfo(depth, alpha, beta, position, ready);
-	lock.unlock();
-	smp.notify_all();
+	uint64_t nodes = 0;
+
+	for (auto i = 0; i < cores; i++)
+		if (const SearchInfo* info = threadInfo[i])
+			nodes += info->Nodes();
+	return nodes;
+}
+
+// hash table probes and the ones that gave a score or a move, summed over the
+// threads of a finished search
+void Search::totalHashStats(uint64_t& probes, uint64_t& hits)
+{
+	probes = 0;
+	hits = 0;
+
+	for (auto i = 0; i < cores; i++)
+		if (const SearchInfo* info = threadInfo[i])
+		{
+			probes += info->HashProbes();
+			hits += info->HashHits();
+		}
+}
+
+// the main thread and every helper zero one slice of the hash table each;
+// on a new table this is also the first touch, so each slice's pages are
+// placed on the node of the thread that clears it
+void Search::clearHash()
+{
+	if (cores > 1)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mux);
+			smpInfo.startClear(cores);
+		}
+		smp.notify_all();
+	}
+
+	Hash.Clear(0, cores);
+
+	if (cores > 1)
+		waitHelpers();
 }
 
-void Search::smpSearch()
+// a new table, zeroed by the search threads
+void Search::setHashSize(const int mb)
 {
-	std::default_random_engine eng;
-	std::uniform_int_distribution<int> score_dist(0, 25); // to tune
+	Hash.setSize(mb);
+	clearHash();
+}
 
+void Search::waitHelpers()
+{
+	std::unique_lock<std::mutex> lock(mux);
+	smp.wait(lock, [] { return smpInfo.Active() == 0; });
+}
+
+// lazy smp: every helper runs its own iterative deepening on a copy of the
+// root position, sharing only the hash table with the other threads. between
+// searches it also zeroes its slice of the table for clearHash
+void Search::smpSearch(const int id, uint64_t searchId)
+{
 	/* thread local information */
 	sendOutput = false;
-	searchInfo.newSearch();
+	threadInfo[id] = &searchInfo;
 
-	const auto move = new Move();
-	const auto position = new Pos();
-	while (!quit)
+	const auto position = std::make_unique<Pos>();
+	while (true)
 	{
 		std::unique_lock<std::mutex> lock(mux);
-		smp.wait(lock, [] { return quit || smpInfo.Ready(); });
-		auto info = smpInfo;
-		lock.unlock();
+		smp.wait(lock, [searchId] { return quit || smpInfo.searchId() != searchId; });
 		if (quit)
 			break;
-		const int rand_window = score_dist(eng);
-		auto fen = info.Board().getFen();
+		searchId = smpInfo.searchId();
 
-		if (position->getFen() != fen)
+		if (smpInfo.Clearing())
+		{
+			lock.unlock();
+			Hash.Clear(id, cores);
+		}
+		else
 		{
+			position->loadState(smpInfo.Root());
+			lock.unlock();
+
 			searchInfo.newSearch();
-			*position = info.Board();
+			searchInfo.setDepthLimit(depth_limit);
+			Eval::cache.setSize(Eval::cacheSize);
+			iterativeSearch(*position, id);
 		}
-		searchRoot(info.Depth(), info.Alpha() - rand_window, info.Beta() + rand_window, std::ref(*move),
-			std::ref(*position));
+
+		lock.lock();
+		smpInfo.helperDone();
+		lock.unlock();
+		smp.notify_all();
 	}
 }
 
-// iterative deepening
-Move Search::iterativeSearch(Pos& position)
+// iterative deepening, returning the last completed iteration
+SearchResult Search::iterativeSearch(Pos& position, const int id)
 {
 	Move move;
-	Move toMake = nullMove;
+	SearchResult result;
 
 	int score = searchRoot(searchInfo.maxDepth(), -Infinity, Infinity, move, position);
+
+	if (score != Unknown)
+		result = {move, score, searchInfo.maxDepth()};
 	searchInfo.incrementDepth();
 
 	while ((searchInfo.maxDepth() < 100 && !searchInfo.timeOver()) || pondering)
@@ -168,18 +274,25 @@ Move Search::iterativeSearch(Pos& position)
 		if (stopSignal)
 			break;
 
-		if (ponderHit)
+		if (id == 0 && ponderHit)
 		{
 			searchInfo.setGameTime(predictTime(position.getSideToMove()));
 			ponderHit = false;
 			pondering = false;
 		}
 
-		searchInfo.SelDepth = 0;
-		searchInfo.resetNodes();
+		if (id > 0)
+		{
+			const int i = (id - 1) % 20;
+
+			if ((searchInfo.maxDepth() + skipPhase[i]) / skipSize[i] % 2)
+			{
+				searchInfo.incrementDepth();
+				continue;
+			}
+		}
 
-		if (searchInfo.maxDepth() > 5 && cores > 1)
-			signalThreads(searchInfo.maxDepth(), -Infinity, Infinity, position, true);
+		searchInfo.SelDepth = 0;
 
 		// aspiration search
 		int temp = searchRoot(searchInfo.maxDepth(), score - aspirationValue, score + aspirationValue, move, position);
@@ -192,21 +305,27 @@ Move Search::iterativeSearch(Pos& position)
 
 		score = temp;
 
-		if (score != Unknown)
-			toMake = move;
+		// a stopped iteration returns the bounds of its window, not a score
+		if (score != Unknown && !stopSignal && !aborted)
+		{
+			result = {move, score, searchInfo.maxDepth()};
+
+			if (cores > 1 && !analysing)
+			{
+				std::lock_guard<std::mutex> lock(mux);
+				smpInfo.setResult(id, move, score, searchInfo.maxDepth());
+			}
+		}
 
 		searchInfo.incrementDepth();
 	}
 
-	stopThinking();
-
-	return toMake;
+	return result;
 }
 
 int Search::searchRoot(const int depth, int alpha, const int beta, Move& moveToMake, Pos& position)
 {
 	int score;
-	const int startTime = static_cast<int>(searchInfo.elapsedTime());
 
 	MovePick moves(position, searchInfo);
 	moveGen::getLegalMoves(moves.moves, moves.count, position);
@@ -228,6 +347,7 @@ int Search::searchRoot(const int depth, int alpha, const int beta, Move& moveToM
 			return Unknown;
 
 		position.makeMove(move);
+		Hash.prefetch(position.zobrist);
 
 		if (i == 0)
 			score = -Search::search<NodeType::PV>(depth - 1, -beta, -alpha, 1, position, false);
@@ -240,6 +360,10 @@ int Search::searchRoot(const int depth, int alpha, const int beta, Move& moveToM
 		}
 		position.undoMove(move);
 
+		// the move was cut off part-way, its score is meaningless
+		if (stopSignal || aborted)
+			return Unknown;
+
 		if (score > alpha)
 		{
 			moveToMake = move;
@@ -247,7 +371,7 @@ int Search::searchRoot(const int depth, int alpha, const int beta, Move& moveToM
 			if (score >= beta)
 			{
 				if (sendOutput)
-					std::cout << "info " << getInfo(position, moveToMake, beta, depth, startTime) << std::endl;
+					std::cout << "info " << getInfo(position, moveToMake, beta, depth) << std::endl;
 				return beta;
 			}
 
@@ -256,7 +380,7 @@ int Search::searchRoot(const int depth, int alpha, const int beta, Move& moveToM
 	}
 
 	if (sendOutput)
-		std::cout << "info " << getInfo(position, moveToMake, alpha, depth, startTime) << std::endl;
+		std::cout << "info " << getInfo(position, moveToMake, alpha, depth) << std::endl;
 
 	return alpha;
 }
@@ -276,11 +400,16 @@ int Search::search(int depth, int alpha, int beta, const int ply, Pos& position,
 	if (ply > searchInfo.SelDepth)
 		searchInfo.SelDepth = ply;
 
-	if (searchInfo.Nodes() % 10000 == 0 && sendOutput)
-		if (searchInfo.timeOver())
+	// the main thread stops every thread, an analysis worker only itself
+	if (searchInfo.Nodes() % 1024 == 0 && (sendOutput || analysing) && searchInfo.timeOver())
+	{
+		if (analysing)
+			aborted = true;
+		else
 			stopSignal = true;
+	}
 
-	if (stopSignal)
+	if (stopSignal || aborted)
 		return alpha;
 
 	// mate distance pruning
@@ -292,6 +421,7 @@ int Search::search(int depth, int alpha, int beta, const int ply, Pos& position,
 
 	// Hash table lookup
 	auto hashHit = Hash.Probe(position.zobrist, depth, alpha, beta);
+	searchInfo.hashProbe(hashHit.first != hashTable::Unknown || !hashHit.second.isNull());
 
 	if ((score = hashHit.first) != hashTable::Unknown)
 		return score;
@@ -336,6 +466,7 @@ int Search::search(int depth, int alpha, int beta, const int ply, Pos& position,
 
 		// cut node
 		position.makeNullMove();
+		Hash.prefetch(position.zobrist);
 
 		// make a null-window search
 		score = -search<NodeType::NONPV>(depth - R - 1, -beta, -beta + 1, ply, position, !cut_node);
@@ -392,10 +523,14 @@ int Search::search(int depth, int alpha, int beta, const int ply, Pos& position,
 
 	MovePick moves(position, searchInfo);
 
-	moveGen::getPseudoLegalMoves<false>(moves.moves, moves.count, attackers, position); // get captures and non-captures
-
-	moves.Sort<false>(ply);
-	moves.hashMove = best;
+	if (attackers)
+	{
+		moveGen::getLegalMoves(moves.moves, moves.count, position); // get evasions
+		moves.Sort<false>(ply);
+		moves.hashMove = best;
+	}
+	else
+		moves.Staged(best, ply); // captures and quiets are generated as they are needed
 
 	// principal variation search
 	bool pruned = false;
@@ -406,13 +541,15 @@ int Search::search(int depth, int alpha, int beta, const int ply, Pos& position,
 
 	for (auto move = moves.First(); !move.isNull(); move = moves.Next())
 	{
-		if (position.isMoveLegal(move, pinned))
+		// evasions are generated legal
+		if (attackers || position.isMoveLegal(move, pinned))
 		{
 			legal++;
 			constexpr int E = 0;
 			newDepth = depth + E;
 			const bool capture = position.isCapture(move);
 			position.makeMove(move);
+			Hash.prefetch(position.zobrist); // probed first thing by the child
 
 			// futility pruning
 			if (futility
@@ -498,7 +635,7 @@ int Search::search(int depth, int alpha, int beta, const int ply, Pos& position,
 	// check for stalemate and checkmate
 	if (legal == 0)
 	{
-		if (position.getIsCheck())
+		if (attackers)
 			alpha = -Mate + ply; // return best score for the deepest mate
 		else
 			alpha = 0; // return draw score
@@ -556,7 +693,7 @@ int Search::quiescence(int alpha, const int beta, Pos& position)
 	if (!inCheck)
 		moveGen::getPseudoLegalMoves<true>(moves.moves, moves.count, attackers, position); // get all capture moves
 	else
-		moveGen::getPseudoLegalMoves<false>(moves.moves, moves.count, attackers, position); // get all evading moves
+		moveGen::getLegalMoves(moves.moves, moves.count, position); // get all evading moves
 
 	moves.Sort<true>();
 
@@ -570,7 +707,7 @@ int Search::quiescence(int alpha, const int beta, Pos& position)
 				continue;
 		}
 
-		if (position.isMoveLegal(move, pinned))
+		if (inCheck || position.isMoveLegal(move, pinned))
 		{
 			position.makeMove(move);
 			const int score = -quiescence(-beta, -alpha, position);
@@ -591,7 +728,7 @@ std::string Search::getPV(Pos& position, const Move toMake, const int depth)
 {
 	std::string pv;
 
-	if (toMake.isNull() || depth == 0)
+	if (toMake.isNull() || depth == 0 || !moveGen::isLegal(toMake, position))
 		return pv;
 	pv = toMake.toAlgebraic() + " ";
 
@@ -602,16 +739,27 @@ std::string Search::getPV(Pos& position, const Move toMake, const int depth)
 	return pv;
 }
 
-std::string Search::getInfo(Pos& position, const Move toMake, const int score, const int depth, const int startTime)
+std::string Search::getInfo(Pos& position, const Move toMake, const int score, const int depth)
 {
 	std::ostringstream info;
-	const double delta = searchInfo.elapsedTime() - startTime;
+	const uint64_t nodes = totalNodes();
+	const double delta = searchInfo.elapsedTime();
 	const double nps = (delta > 0
-		? searchInfo.Nodes() * static_cast<double>(cores) / delta
-		: searchInfo.Nodes() * static_cast<double>(cores) / 1) * static_cast<double>(1000);
+		? nodes / delta
+		: nodes / 1.0) * static_cast<double>(1000);
+
+	info << "depth " << depth << " seldepth " << searchInfo.SelDepth
+		<< " score " << scoreToUci(score)
+		<< " time " << searchInfo.elapsedTime()
+		<< " nodes " << nodes
+		<< " nps " << static_cast<int>(nps)
+		<< " pv " << getPV(position, toMake, depth);
 
-	info << "depth " << depth << " seldepth " << searchInfo.SelDepth;
+	return info.str();
+}
 
+std::string Search::scoreToUci(const int score)
+{
 	if (std::abs(score) >= Mate - maxPly)
 	{
 		int plies = Mate - std::abs(score) + 1;
@@ -619,23 +767,18 @@ std::string Search::getInfo(Pos& position, const Move toMake, const int score, c
 		if (score < 0) // mated
 			plies *= -1;
 
-		info << " score mate " << plies / 2;
+		return "mate " + std::to_string(plies / 2);
 	}
-	else
-		info << " score cp " << score;
-
-	info << " time " << searchInfo.elapsedTime()
-		<< " nodes " << searchInfo.Nodes() * cores
-		<< " nps " << static_cast<int>(nps)
-		<< " pv " << getPV(position, toMake, depth);
-
-	return info.str();
+	return "cp " + std::to_string(score);
 }
 
 Move Search::getPonderMove(Pos& position, const Move toMake)
 {
 	position.makeMove(toMake);
-	const Move move = Hash.getPV(position.zobrist);
+	Move move = Hash.getPV(position.zobrist);
+
+	if (!move.isNull() && !moveGen::isLegal(move, position))
+		move = nullMove;
 	position.undoMove(toMake);
 
 	return move;
@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <condition_variable>
 #include <vector>
 #include "searchinfo.h"
@@ -25,13 +26,15 @@ class hashTable;
 
 namespace Search
 {
-	extern bool pondering;
+	extern std::atomic<bool> pondering;
 	extern std::atomic<bool> ponderHit;
 	extern std::atomic<bool> stopSignal;
 	extern int moveTime;
 	extern int gameTime[2];
 	extern thread_local SearchInfo searchInfo;
 	extern thread_local bool sendOutput;
+	extern thread_local bool analysing;
+	extern thread_local bool aborted;
 	extern hashTable Hash;
 	extern std::condition_variable smp;
 	extern SMPInfo smpInfo;
@@ -40,21 +43,29 @@ namespace Search
 	extern int cores;
 	extern std::atomic<bool> quit;
 	extern const int defaultCores;
+	constexpr int maxThreads = 64;
+	extern std::atomic<const SearchInfo*> threadInfo[maxThreads]; // published by each thread, read by the main one
 
 	void initThreads(int = defaultCores);
 	void killThreads();
-	void signalThreads(int, int, int, const Pos&, bool);
-	void smpSearch();
+	void startHelpers(const Pos&);
+	void waitHelpers();
+	void clearHash();
+	void setHashSize(int);
+	uint64_t totalNodes();
+	void totalHashStats(uint64_t&, uint64_t&);
+	void smpSearch(int, uint64_t);
 	int razorMargin(int);
 	int futilityMargin(int);
 	int predictTime(uint8_t);
 
-	std::string getInfo(Pos&, Move, int, int, int);
+	std::string getInfo(Pos&, Move, int, int);
+	std::string scoreToUci(int);
 	std::string getPV(Pos&, Move, int);
 	Move getPonderMove(Pos&, Move);
 	Move startThinking(SearchType, Pos&, bool = true);
 	void stopThinking();
-	Move iterativeSearch(Pos&);
+	SearchResult iterativeSearch(Pos&, int = 0);
 	int searchRoot(int, int, int, Move&, Pos&);
 	template <NodeType>
 	int search(int, int, int, int, Pos&, bool);
@@ -1,9 +1,9 @@
 #include "searchinfo.h"
 
 SearchInfo::SearchInfo(const int time, const int depth, const int nodes) noexcept :
-	depth(depth),
-	nodes(nodes)
+	depth(depth)
 {
+	this->nodes.Nodes = nodes;
 	SelDepth = 0;
 	allocatedTime = time;
 	setDepthLimit(100);
@@ -27,6 +27,9 @@ void SearchInfo::setDepthLimit(const int depth)
 void SearchInfo::newSearch(const int time)
 {
 	resetNodes();
+	hashProbes = 0;
+	hashHits = 0;
+	nodeLimit = 0;
 	allocatedTime = time;
 	depth = 1;
 	memset(history, 0, sizeof(history));
@@ -41,7 +44,13 @@ void SearchInfo::stopSearch()
 
 void SearchInfo::resetNodes()
 {
-	nodes = 0;
+	nodes.Nodes.store(0, std::memory_order_relaxed);
+}
+
+// zero for no limit
+void SearchInfo::setNodeLimit(const uint64_t nodes)
+{
+	nodeLimit = nodes;
 }
 
 void SearchInfo::setGameTime(const int time)
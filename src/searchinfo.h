@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <cstring>
 #include "square.h"
 #include "clock.h"
@@ -6,6 +7,13 @@
 constexpr int maxPly = 1024;
 class Move;
 
+// written only by its own thread and summed by the main thread, so it gets
+// a cache line of its own
+struct alignas(64) NodeCounter
+{
+	std::atomic<uint64_t> Nodes{};
+};
+
 class SearchInfo
 {
 public:
@@ -16,13 +24,17 @@ public:
 	void stopSearch();
 	int incrementDepth();
 	int maxDepth() const;
-	int Nodes() const;
+	uint64_t Nodes() const;
+	uint64_t HashProbes() const;
+	uint64_t HashHits() const;
 	bool timeOver() const;
 	void resetNodes();
 	void visitNode();
+	void hashProbe(bool);
 	void setKillers(Move, int);
 	void setHistory(Move, uint8_t, int);
 	void setDepthLimit(int);
+	void setNodeLimit(uint64_t);
 	void setGameTime(int);
 	Move firstKiller(int) const;
 	Move secondKiller(int) const;
@@ -32,8 +44,11 @@ public:
 
 private:
 	int depthLimit{};
+	uint64_t nodeLimit{};
 	int depth;
-	int nodes;
+	NodeCounter nodes;
+	uint64_t hashProbes{};
+	uint64_t hashHits{};
 	int history[2][64 * 64]{};
 	int allocatedTime;
 	Move killers[maxPly][2];
@@ -42,20 +57,40 @@ private:
 
 inline bool SearchInfo::timeOver() const
 {
+	if (nodeLimit && Nodes() >= nodeLimit)
+		return true;
+
 	if (allocatedTime == static_cast<int>(Time::Infinite) && depth <= depthLimit)
 		return false;
 
 	return (timer.elapsedMilliseconds() >= allocatedTime || timer.elapsedMilliseconds() / allocatedTime >= 0.85);
 }
 
-inline int SearchInfo::Nodes() const
+inline uint64_t SearchInfo::Nodes() const
 {
-	return nodes;
+	return nodes.Nodes.load(std::memory_order_relaxed);
 }
 
 inline void SearchInfo::visitNode()
 {
-	++nodes;
+	nodes.Nodes.store(nodes.Nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// read by other threads only once the search is over
+inline void SearchInfo::hashProbe(const bool hit)
+{
+	hashProbes++;
+	hashHits += hit;
+}
+
+inline uint64_t SearchInfo::HashProbes() const
+{
+	return hashProbes;
+}
+
+inline uint64_t SearchInfo::HashHits() const
+{
+	return hashHits;
 }
 
 inline Move SearchInfo::firstKiller(const int depth) const
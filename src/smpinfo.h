@@ -1,52 +1,109 @@
 #pragma once
+#include <algorithm>
+#include <vector>
 #include "position.h"
 
+struct SearchResult
+{
+	Move BestMove;
+	int Score = 0;
+	int Depth = 0;
+};
+
 class SMPInfo
 {
 public:
-	void updateInfo(const int depth, const int alpha, const int beta, const Pos& position, const bool ready)
+	void startSearch(const Pos& position, const int threads)
+	{
+		position.saveState(root_);
+		results_.assign(threads, SearchResult());
+		active_ = threads - 1;
+		clearing_ = false;
+		++search_id_;
+	}
+
+	// the helpers zero their slices of the hash table instead of searching
+	void startClear(const int threads)
+	{
+		active_ = threads - 1;
+		clearing_ = true;
+		++search_id_;
+	}
+
+	void setResult(const int id, const Move move, const int score, const int depth)
 	{
-		this->beta_ = beta;
-		this->depth_ = depth;
-		this->alpha_ = alpha;
-		this->position_ = position;
-		ready_to_search_ = ready;
+		results_[id].BestMove = move;
+		results_[id].Score = score;
+		results_[id].Depth = depth;
 	}
 
-	int Alpha() const
+	// every thread votes for its best move, weighted by depth and by how far
+	// its score is above the worst one; the main thread wins ties
+	Move bestMove() const
 	{
-		return alpha_;
+		const auto first = std::find_if(results_.begin(), results_.end(),
+			[](const SearchResult& result) { return result.Depth > 0; });
+
+		if (first == results_.end())
+			return results_[0].BestMove;
+
+		int minScore = first->Score;
+		int best = 0;
+		int64_t bestVotes = 0;
+
+		for (const auto& result : results_)
+			if (result.Depth > 0)
+				minScore = std::min(minScore, result.Score);
+
+		for (size_t i = 0; i < results_.size(); i++)
+		{
+			if (results_[i].Depth == 0 || results_[i].BestMove.isNull())
+				continue;
+
+			int64_t votes = 0;
+
+			for (const auto& result : results_)
+				if (result.Depth > 0 && result.BestMove == results_[i].BestMove)
+					votes += static_cast<int64_t>(result.Score - minScore + 14) * result.Depth;
+
+			if (votes > bestVotes)
+			{
+				bestVotes = votes;
+				best = static_cast<int>(i);
+			}
+		}
+		return results_[best].BestMove;
 	}
 
-	int Beta() const
+	void helperDone()
 	{
-		return beta_;
+		--active_;
 	}
 
-	int Depth() const
+	int Active() const
 	{
-		return depth_;
+		return active_;
 	}
 
-	Pos Board()
+	bool Clearing() const
 	{
-		return position_;
+		return clearing_;
 	}
 
-	bool Ready() const
+	uint64_t searchId() const
 	{
-		return ready_to_search_;
+		return search_id_;
 	}
 
-	void setReady(const bool ready)
+	const RootState& Root() const
 	{
-		ready_to_search_ = ready;
+		return root_;
 	}
 
 private:
-	int alpha_ = 0;
-	int beta_ = 0;
-	int depth_ = 0;
-	Pos position_;
-	bool ready_to_search_ = false;
+	RootState root_;
+	std::vector<SearchResult> results_;
+	int active_ = 0;
+	bool clearing_ = false;
+	uint64_t search_id_ = 0;
 };
@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include "search.h"
 #include "benchmark.h"
+#include "eval.h"
+#include "analysis.h"
+#include "nnue-probe/nnue.h"
 
 using namespace std;
 Pos Uci::position;
@@ -23,6 +29,8 @@ void Uci::Start()
 			cout << "id author " << AUTHOR << endl;
 			cout << "option name Hash type spin default 32 min 1 max 1024" << endl;
 			cout << "option name Threads type spin default 1 min 1 max 64" << endl;
+			cout << "option name EvalCache type spin default " << EvalCache::defaultSize
+				<< " min " << EvalCache::minSize << " max " << EvalCache::maxSize << endl;
 			cout << "uciok" << endl;
 		}
 		else if (cmd == "isready")
@@ -31,7 +39,7 @@ void Uci::Start()
 		}
 		else if (cmd == "ucinewgame")
 		{
-			Search::Hash.Clear();
+			Search::clearHash();
 		}
 		else if (cmd == "setoption")
 		{
@@ -40,10 +48,10 @@ void Uci::Start()
 			stream >> token;
 			if (token == "Hash")
 			{
-				int size;
+				int size = 32;
 				stream >> token;
 				stream >> size;
-				Search::Hash.setSize(size);
+				Search::setHashSize(std::clamp(size, 1, 1024));
 			}
 			else if (token == "Threads")
 			{
@@ -51,6 +59,15 @@ void Uci::Start()
 				stream >> token;
 				stream >> threads;
 				Search::initThreads(threads);
+				// a fresh table, so that each new thread first touches its slice
+				Search::setHashSize(std::max(1, Search::Hash.Size()));
+			}
+			else if (token == "EvalCache")
+			{
+				int size = EvalCache::defaultSize;
+				stream >> token;
+				stream >> size;
+				Eval::cacheSize = std::clamp(size, EvalCache::minSize, EvalCache::maxSize);
 			}
 		}
 		else if (cmd == "position")
@@ -95,30 +112,59 @@ void Uci::Start()
 		}
 		else if (cmd == "perft")
 		{
-			Benchmark bench(position);
+			// perft <depth> [hash size in mb, 0 for none], split over the Threads option
 			int depth = 6;
+			int hashSize;
 			stream >> depth;
+			if (!(stream >> hashSize))
+				hashSize = Benchmark::perftHash;
+			Benchmark bench(position, hashSize);
 			bench.runPerft(depth);
 		}
 		else if (cmd == "divide")
 		{
-			Benchmark bench(position);
+			// divide <depth> [hash size in mb, 0 for none], split over the Threads option
 			int depth = 6;
+			int hashSize;
 			stream >> depth;
+			if (!(stream >> hashSize))
+				hashSize = Benchmark::perftHash;
+			Benchmark bench(position, hashSize);
 			bench.runDivide(depth);
 		}
 		else if (cmd == "bench")
 		{
-			Benchmark bench(position);
-			int depth = 8;
-			stream >> depth;
-			bench.ttdTest(depth);
+			if (Search::stopSignal)
+				Bench(stream);
+		}
+		else if (cmd == "analyze")
+		{
+			if (Search::stopSignal)
+				Analyze(stream);
+		}
+		else if (cmd == "evaluate")
+		{
+			if (Search::stopSignal)
+				Evaluate(stream);
+		}
+		else if (cmd == "writecache")
+		{
+			WriteCache();
+		}
+		else if (cmd == "verifycache")
+		{
+			VerifyCache();
 		}
 		else if (cmd == "perfttest")
 		{
 			Benchmark bench(position);
 			bench.perftTest();
 		}
+		else if (cmd == "matetest")
+		{
+			if (Search::stopSignal)
+				MateTest();
+		}
 		else if (cmd == "disp")
 		{
 			position.Display();
@@ -166,6 +212,105 @@ void Uci::Go(istringstream& stream)
 	search.detach();
 }
 
+// bench [depth] [baseline <csv file> [threshold percent]]
+int Uci::Bench(istringstream& stream)
+{
+	int depth = 8;
+	int threshold = Benchmark::benchThreshold;
+	string token;
+	string baseline;
+
+	// the depth is optional, so "bench baseline x.csv" starts with the keyword
+	if (stream >> token && std::isdigit(static_cast<unsigned char>(token[0])))
+	{
+		depth = std::atoi(token.c_str());
+		stream >> token;
+	}
+
+	if (token == "baseline")
+	{
+		stream >> baseline;
+
+		if (!(stream >> threshold))
+			threshold = Benchmark::benchThreshold;
+	}
+
+	const Benchmark bench(position, 0);
+	return bench.runBench(depth, baseline, threshold);
+}
+
+// analyze <epd file> depth|nodes|movetime <value>
+int Uci::Analyze(istringstream& stream)
+{
+	string fileName;
+	string token;
+	uint64_t value = 0;
+	stream >> fileName >> token >> value;
+
+	if (value == 0 || (token != "depth" && token != "nodes" && token != "movetime"))
+	{
+		cout << "info string usage: analyze <epd file> depth|nodes|movetime <value>" << endl;
+		return 1;
+	}
+
+	const auto limit = token == "depth"
+		? Analysis::Limit::Depth
+		: token == "nodes"
+		? Analysis::Limit::Nodes
+		: Analysis::Limit::MoveTime;
+	return Analysis::analyzeFile(fileName, limit, value);
+}
+
+// evaluate <epd file>
+int Uci::Evaluate(istringstream& stream)
+{
+	string fileName;
+
+	if (!(stream >> fileName))
+	{
+		cout << "info string usage: evaluate <epd file>" << endl;
+		return 1;
+	}
+
+	return Analysis::evaluateFile(fileName);
+}
+
+// writecache: the loaded network in the layout of the nnue kernels of this
+// cpu, next to the net file. later starts map it instead of reading the net
+int Uci::WriteCache()
+{
+	if (!nnue_write_cache(NNUE_FILE))
+	{
+		cout << "info string cannot write the cache of " << NNUE_FILE << endl;
+		return 1;
+	}
+
+	cout << "info string wrote " << NNUE_FILE << ".cache for " << nnue_kernels() << " kernels" << endl;
+	return 0;
+}
+
+// verifycache: the cache against the whole net file, a start only checks
+// the size and a sample of it
+int Uci::VerifyCache()
+{
+	if (!nnue_verify_cache(NNUE_FILE))
+	{
+		cout << "info string " << NNUE_FILE << ".cache does not match " << NNUE_FILE << endl;
+		return 1;
+	}
+
+	cout << "info string " << NNUE_FILE << ".cache matches " << NNUE_FILE << endl;
+	return 0;
+}
+
+// matetest: mates in one searched to a small depth, the status is the
+// number of them missed
+int Uci::MateTest()
+{
+	const Benchmark bench(position, 0);
+	return bench.mateTest();
+}
+
 void Uci::engineInfo()
 {
 	const auto startup_banner = "" ENGINE " " VERSION " " PLATFORM "\n";
@@ -9,6 +9,12 @@ namespace Uci
 {
 	void Start();
 	void Go(std::istringstream&);
+	int Bench(std::istringstream&);
+	int Analyze(std::istringstream&);
+	int Evaluate(std::istringstream&);
+	int WriteCache();
+	int VerifyCache();
+	int MateTest();
 	void engineInfo();
 	extern Pos position;
 	extern std::thread search;
@@ -38,12 +38,12 @@ void Zobrist::Init()
 		}
 	}
 	Color = gen.Next();
-	for (unsigned long long& i : Castling)
+	for (auto& i : Castling)
 	{
 		i = gen.Next();
 	}
 
-	for (unsigned long long& i : Enpassant)
+	for (auto& i : Enpassant)
 	{
 		i = gen.Next();
 	}